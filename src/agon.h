@@ -59,6 +59,7 @@
 #define PACKET_MODE				0x06	// Get screen dimensions
 #define PACKET_RTC				0x07	// RTC
 #define PACKET_KEYSTATE			0x08	// Keyboard repeat rate and LED status
+#define PACKET_OTF_COLLISION	0x1E	// OTF mode primitive collisions (matches VDU 23, 30)
 
 #define AUDIO_CHANNELS			3		// Number of audio channels
 #define PLAY_SOUND_PRIORITY 	2		// Sound driver task priority with 3 (configMAX_PRIORITIES - 1) being the highest, and 0 being the lowest
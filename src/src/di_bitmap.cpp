@@ -34,34 +34,65 @@
 #include <cstring>
 //extern void debug_log(const char* fmt, ...);
 
-DiBitmap::DiBitmap(uint32_t width, uint32_t height, uint16_t flags) {
+DiBitmapAsset::DiBitmapAsset(uint32_t bytes, uint8_t memory) {
+  m_ref_count = 1;
+  m_transparent_color = 0;
+  m_code_valid = false;
+  m_in_psram = false;
+  m_pixels = NULL;
+  if (memory == BITMAP_MEMORY_PSRAM) {
+    // Fall back to internal RAM if there is no (or not enough) PSRAM.
+    m_pixels = (uint32_t*) heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+    m_in_psram = (m_pixels != NULL);
+  }
+  if (!m_pixels) {
+    m_pixels = new uint32_t[bytes / sizeof(uint32_t)];
+  }
+  memset(m_pixels, 0x00, bytes);
+}
+
+DiBitmapAsset::~DiBitmapAsset() {
+  if (m_in_psram) {
+    heap_caps_free(m_pixels);
+  } else {
+    delete [] m_pixels;
+  }
+}
+
+void DiBitmapAsset::release() {
+  if (--m_ref_count == 0) {
+    delete this;
+  }
+}
+
+//---------------------------------------------------------------------
+
+DiBitmap::DiBitmap(uint32_t width, uint32_t height, uint16_t flags, uint8_t memory) {
   //debug_log(" @%i ",__LINE__);
   m_width = width;
   m_height = height;
   m_save_height = height;
   m_flags = flags;
-  m_transparent_color = 0;
+  m_visible_line = 0;
+  m_anim_frames = 0;
+  m_flip = 0;
 
-  if (flags & PRIM_FLAG_H_SCROLL_1) {
-      m_words_per_line = ((width + sizeof(uint32_t) - 1) / sizeof(uint32_t) + 2);
-      m_bytes_per_line = m_words_per_line * sizeof(uint32_t);
-      m_words_per_position = m_words_per_line * height;
-      m_bytes_per_position = m_words_per_position * sizeof(uint32_t);
-      m_pixels = new uint32_t[m_words_per_position * 4];
-      memset(m_pixels, 0x00, m_bytes_per_position * 4);
-      for (uint32_t pos = 0; pos < 4; pos++) {
-        m_paint_fcn[pos].enter_and_leave_outer_function();
-      }
-  } else {
-      m_words_per_line = ((width + sizeof(uint32_t) - 1) / sizeof(uint32_t));
-      m_bytes_per_line = m_words_per_line * sizeof(uint32_t);
-      m_words_per_position = m_words_per_line * height;
-      m_bytes_per_position = m_words_per_position * sizeof(uint32_t);
-      m_pixels = new uint32_t[m_words_per_position];
-      memset(m_pixels, 0x00, m_bytes_per_position);
-      m_paint_fcn[0].enter_and_leave_outer_function();
-  }
+  m_words_per_line = ((width + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+  m_bytes_per_line = m_words_per_line * sizeof(uint32_t);
+  m_words_per_position = m_words_per_line * height;
+  m_bytes_per_position = m_words_per_position * sizeof(uint32_t);
+  m_asset = new DiBitmapAsset(m_bytes_per_position, memory);
+  m_pixels = m_asset->get_pixels();
   m_visible_start = m_pixels;
+  m_line_cache = NULL;
+  m_cache_tags = NULL;
+  if (m_asset->is_in_psram()) {
+    create_line_cache();
+  }
+  m_paint_fcns = m_paint_fcn;
+  for (uint32_t pos = 0; pos < 4; pos++) {
+    m_paint_fcn[pos].enter_and_leave_outer_function();
+  }
   //debug_log(" @%i ",__LINE__);
 }
 
@@ -70,28 +101,97 @@ DiBitmap::DiBitmap(uint16_t flags, DiBitmap* ref_bitmap) {
   m_width = ref_bitmap->m_width;
   m_height = ref_bitmap->m_height;
   m_save_height = ref_bitmap->m_save_height;
-  m_flags = flags | (ref_bitmap->m_flags & (PRIM_FLAG_H_SCROLL_1|PRIM_FLAGS_BLENDED)) | PRIM_FLAGS_REF_DATA;
-  m_transparent_color = ref_bitmap->m_transparent_color;
+  // The flags that affect the paint code come from the referenced bitmap, so that all
+  // bitmaps using the same asset can share that code.
+  m_flags = (flags & ~BITMAP_SHARED_FLAGS) | (ref_bitmap->m_flags & BITMAP_SHARED_FLAGS) | PRIM_FLAGS_REF_DATA;
   m_words_per_line = ref_bitmap->m_words_per_line;
   m_bytes_per_line = ref_bitmap->m_bytes_per_line;
   m_words_per_position = ref_bitmap->m_words_per_position;
   m_bytes_per_position = ref_bitmap->m_bytes_per_position;
-  m_pixels = ref_bitmap->m_pixels;
+  m_asset = ref_bitmap->m_asset;
+  m_asset->add_ref();
+  m_pixels = m_asset->get_pixels();
   m_visible_start = m_pixels;
+  m_visible_line = 0;
+  m_anim_frames = 0;
+  m_flip = 0;
+  m_line_cache = NULL;
+  m_cache_tags = NULL;
+  if (m_asset->is_in_psram()) {
+    create_line_cache();
+  }
+  m_paint_fcns = m_paint_fcn;
+  for (uint32_t pos = 0; pos < 4; pos++) {
+    m_paint_fcn[pos].enter_and_leave_outer_function();
+  }
   //debug_log(" @%i ",__LINE__);
 }
 
-
 DiBitmap::~DiBitmap() {
-  if (!(m_flags & PRIM_FLAGS_REF_DATA)) {
-    delete [] m_pixels;
+  m_asset->release();
+  if (m_line_cache) {
+    heap_caps_free(m_line_cache);
+    delete [] m_cache_tags;
+  }
+}
+
+void DiBitmap::create_line_cache() {
+  m_line_cache = (uint32_t*) heap_caps_malloc(m_bytes_per_line * BITMAP_CACHE_LINES,
+                  MALLOC_CAP_INTERNAL|MALLOC_CAP_32BIT);
+  if (m_line_cache) {
+    m_cache_tags = new uint32_t*[BITMAP_CACHE_LINES];
+    for (uint32_t i = 0; i < BITMAP_CACHE_LINES; i++) {
+      m_cache_tags[i] = NULL;
+    }
   }
+  m_prefetch_line = 0;
+}
+
+void IRAM_ATTR DiBitmap::start_line_cache() {
+  for (uint32_t i = 0; i < BITMAP_CACHE_LINES; i++) {
+    m_cache_tags[i] = NULL;
+  }
+  m_prefetch_line = m_draw_y;
+  prefetch_lines(m_draw_y + BITMAP_CACHE_LINES);
+}
+
+void IRAM_ATTR DiBitmap::prefetch_lines(int32_t end_line_index) {
+  if (!(m_flags & PRIM_FLAGS_CAN_DRAW)) {
+    return;
+  }
+  if (m_prefetch_line < m_draw_y) {
+    m_prefetch_line = m_draw_y;
+  }
+  if (end_line_index > m_draw_y_extent) {
+    end_line_index = m_draw_y_extent;
+  }
+  // A line shares its cache slot with the line BITMAP_CACHE_LINES above it, so the
+  // caller must not prefetch further ahead than that from the line being drawn.
+  while (m_prefetch_line < end_line_index) {
+    get_cached_line(m_prefetch_line, m_visible_start + get_source_row(m_prefetch_line) * m_words_per_line);
+    m_prefetch_line++;
+  }
+}
+
+uint32_t* IRAM_ATTR DiBitmap::get_cached_line(int32_t line_index, uint32_t* src_pixels) {
+  // The tag is the PSRAM address of the line, so slices and animation frames are
+  // fetched again whenever the visible part of the bitmap changes.
+  auto slot = line_index & (BITMAP_CACHE_LINES - 1);
+  auto cached_pixels = m_line_cache + slot * m_words_per_line;
+  if (m_cache_tags[slot] != src_pixels) {
+    memcpy(cached_pixels, src_pixels, m_bytes_per_line);
+    m_cache_tags[slot] = src_pixels;
+  }
+  return cached_pixels;
 }
 
 void IRAM_ATTR DiBitmap::set_relative_position(int32_t x, int32_t y) {
   //debug_log(" @%i ",__LINE__);
   DiPrimitive::set_relative_position(x, y);
-  m_visible_start = m_pixels;
+  if (!is_animated()) {
+    m_visible_line = 0;
+    m_visible_start = m_pixels;
+  }
   //debug_log(" @%i ",__LINE__);
 }
 
@@ -99,41 +199,227 @@ void DiBitmap::set_slice_position(int32_t x, int32_t y, uint32_t start_line, uin
   //debug_log(" @%i ",__LINE__);
   DiPrimitive::set_relative_position(x, y);
   m_height = height;
+  m_visible_line = start_line;
   m_visible_start = m_pixels + start_line * m_words_per_line;
   //debug_log(" @%i ",__LINE__);
 }
 
+void IRAM_ATTR DiBitmap::set_visible_line(uint32_t start_line) {
+  if (start_line + m_height <= m_save_height) {
+    m_visible_line = start_line;
+    m_visible_start = m_pixels + start_line * m_words_per_line;
+  }
+}
+
+void DiBitmap::set_flip(uint8_t flip) {
+  flip &= (BITMAP_FLIP_H|BITMAP_FLIP_V);
+  bool regenerate = ((flip ^ m_flip) & BITMAP_FLIP_H) != 0;
+  m_flip = flip;
+  if (regenerate && (m_flags & PRIM_FLAGS_CAN_DRAW)) {
+    generate_instructions();
+  }
+}
+
+DiBitmap* DiBitmap::as_bitmap() {
+  return this;
+}
+
+void DiBitmap::set_animation(uint32_t frame_height, uint32_t num_frames, uint32_t frames_per_step, uint8_t mode) {
+  if (frame_height == 0 || frame_height * num_frames > m_save_height) {
+    num_frames = 0;
+  }
+  m_anim_frames = (num_frames > 1) ? num_frames : 0;
+  m_anim_frame = 0;
+  m_anim_frames_per_step = (frames_per_step ? frames_per_step : 1);
+  m_anim_countdown = m_anim_frames_per_step;
+  m_anim_direction = 1;
+  m_anim_mode = mode;
+  m_visible_line = 0;
+  m_visible_start = m_pixels;
+  if (m_anim_frames) {
+    m_anim_frame_height = frame_height;
+    m_height = frame_height;
+  }
+}
+
+bool IRAM_ATTR DiBitmap::animate() {
+  if (!m_anim_frames || --m_anim_countdown) {
+    return false;
+  }
+  m_anim_countdown = m_anim_frames_per_step;
+
+  int32_t frame = (int32_t)m_anim_frame + m_anim_direction;
+  if (m_anim_mode & BITMAP_ANIM_PING_PONG) {
+    if (frame >= (int32_t)m_anim_frames) {
+      m_anim_direction = -1;
+      frame = m_anim_frames - 2;
+    } else if (frame < 0) {
+      m_anim_direction = 1;
+      frame = 1;
+    }
+  } else if (frame >= (int32_t)m_anim_frames) {
+    frame = 0;
+  }
+  m_anim_frame = (uint16_t)frame;
+
+  // Only the start of the visible slice changes, so the paint groups stay the same.
+  m_visible_line = m_anim_frame * m_anim_frame_height;
+  m_visible_start = m_pixels + m_visible_line * m_words_per_line;
+  return true;
+}
+
 void DiBitmap::set_transparent_pixel(int32_t x, int32_t y, uint8_t color) {
   // Invert the meaning of the alpha bits.
   set_pixel(x, y, PIXEL_ALPHA_INV_MASK(color));
 }
 
 void DiBitmap::set_transparent_color(uint8_t color) {
-  m_transparent_color = PIXEL_ALPHA_INV_MASK(color);
+  m_asset->set_transparent_color(PIXEL_ALPHA_INV_MASK(color));
 }
 
 void DiBitmap::set_pixel(int32_t x, int32_t y, uint8_t color) {
   uint32_t* p;
   int32_t index;
 
-  if (m_flags & PRIM_FLAG_H_SCROLL_1) {
-    for (uint32_t pos = 0; pos < 4; pos++) {
-      p = m_pixels + pos * m_words_per_position + y * m_words_per_line + (FIX_INDEX(pos+x) / 4);
-      index = FIX_INDEX((pos+x)&3);
-      pixels(p)[index] = color;
+  p = m_pixels + y * m_words_per_line + (FIX_INDEX(x) / 4);
+  index = FIX_INDEX(x&3);
+  pixels(p)[index] = color;
+  m_asset->set_code_valid(false);
+}
+
+void DiBitmap::fill_span(uint8_t* line_bytes, int32_t x, int32_t count, uint8_t color) {
+  int32_t x_extent = x + count;
+  while (x < x_extent && (x & 3)) {
+    line_bytes[FIX_INDEX(x)] = color;
+    x++;
+  }
+  // Whole words hold 4 pixels of the same color, so the byte order does not matter.
+  auto word = PIXEL_COLOR_X4(color);
+  while (x + 4 <= x_extent) {
+    *((uint32_t*)(line_bytes + x)) = word;
+    x += 4;
+  }
+  while (x < x_extent) {
+    line_bytes[FIX_INDEX(x)] = color;
+    x++;
+  }
+}
+
+void DiBitmap::decode_pixels(int32_t x, int32_t y, const uint8_t* data, uint32_t size) {
+  if (x < 0 || y < 0 || x >= m_width) {
+    return;
+  }
+  m_asset->set_code_valid(false);
+  auto data_end = data + size;
+  auto line_bytes = (uint8_t*)(m_pixels + y * m_words_per_line);
+  int32_t line = y;
+
+  while (data < data_end && line < (int32_t)m_save_height) {
+    uint8_t token = *data++;
+    if (token < BITMAP_CODE_RUN) {
+      // Literal colors
+      int32_t count = token + 1;
+      while (count-- && data < data_end && line < (int32_t)m_save_height) {
+        line_bytes[FIX_INDEX(x)] = PIXEL_ALPHA_INV_MASK(*data++);
+        if (++x >= m_width) {
+          x = 0;
+          line++;
+          line_bytes += m_bytes_per_line;
+        }
+      }
+    } else if (token < BITMAP_CODE_COPY) {
+      // Run of one color, written one line span at a time
+      if (data >= data_end) {
+        break;
+      }
+      int32_t count = (token & 0x3F) + 2;
+      uint8_t color = PIXEL_ALPHA_INV_MASK(*data++);
+      while (count && line < (int32_t)m_save_height) {
+        int32_t span = MIN(count, m_width - x);
+        fill_span(line_bytes, x, span, color);
+        count -= span;
+        x += span;
+        if (x >= m_width) {
+          x = 0;
+          line++;
+          line_bytes += m_bytes_per_line;
+        }
+      }
+    } else {
+      // Copy of earlier pixels (which may overlap the pixels being written)
+      if (data + 2 > data_end) {
+        break;
+      }
+      int32_t count = (token & 0x3F) + 3;
+      int32_t distance = (int32_t)data[0] | ((int32_t)data[1] << 8);
+      data += 2;
+      int32_t src_position = line * m_width + x - distance;
+      if (distance == 0 || src_position < 0) {
+        break;
+      }
+      int32_t src_line = src_position / m_width;
+      int32_t src_x = src_position - src_line * m_width;
+      auto src_bytes = (uint8_t*)(m_pixels + src_line * m_words_per_line);
+      while (count-- && line < (int32_t)m_save_height) {
+        line_bytes[FIX_INDEX(x)] = src_bytes[FIX_INDEX(src_x)];
+        if (++src_x >= m_width) {
+          src_x = 0;
+          src_bytes += m_bytes_per_line;
+        }
+        if (++x >= m_width) {
+          x = 0;
+          line++;
+          line_bytes += m_bytes_per_line;
+        }
+      }
     }
-  } else {
-    p = m_pixels + y * m_words_per_line + (FIX_INDEX(x) / 4);
-    index = FIX_INDEX(x&3);
-    pixels(p)[index] = color;
   }
 }
 
+bool DiBitmap::get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  // Only a solid bitmap (every pixel fully opaque) hides what is beneath it.
+  if (!(m_flags & PRIM_FLAGS_ALL_SAME) || (m_flags & (PRIM_FLAGS_MASKED|PRIM_FLAGS_BLENDED))) {
+    return false;
+  }
+  x = m_draw_x;
+  x_extent = m_draw_x_extent;
+  return true;
+}
+
+bool DiBitmap::find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  if (!DiPrimitive::find_drawn_run(line_index, x, x_extent)) {
+    return false;
+  }
+  if (m_flags & PRIM_FLAGS_ALL_SAME) {
+    return true; // a solid bitmap has no transparent pixels
+  }
+
+  // Check the visible slice for transparent pixels.
+  auto src_pixels = (uint8_t*)(m_visible_start + get_source_row(line_index) * m_words_per_line);
+  auto transparent_color = m_asset->get_transparent_color();
+  int32_t col = x - m_abs_x;
+  int32_t col_extent = x_extent - m_abs_x;
+  while (col < col_extent && src_pixels[FIX_INDEX(get_source_column(col))] == transparent_color) {
+    col++;
+  }
+  if (col >= col_extent) {
+    return false;
+  }
+  x = m_abs_x + col;
+  while (col < col_extent && src_pixels[FIX_INDEX(get_source_column(col))] != transparent_color) {
+    col++;
+  }
+  x_extent = m_abs_x + col;
+  return true;
+}
+
 void IRAM_ATTR DiBitmap::delete_instructions() {
   //debug_log(" @%i ",__LINE__);
+  // Shared code belongs to the asset, and is left alone.
   for (uint32_t pos = 0; pos < 4; pos++) {
     m_paint_fcn[pos].clear();
   }
+  m_paint_fcns = m_paint_fcn;
   //debug_log(" @%i ",__LINE__);
 }
 
@@ -141,61 +427,136 @@ void IRAM_ATTR DiBitmap::generate_instructions() {
   //debug_log(" @%i ",__LINE__);
   delete_instructions();
   if (m_flags & PRIM_FLAGS_CAN_DRAW) {
-    if (m_flags & PRIM_FLAG_H_SCROLL_1) {
-      // Bitmap can be positioned on any horizontal byte boundary (pixel offsets 0..3).
-      for (uint32_t pos = 0; pos < 4; pos++) {
-        EspFixups fixups;
-        EspFunction* paint_fcn = &m_paint_fcn[pos];
-        uint32_t* src_pixels = m_pixels + pos * m_words_per_position;
-        uint32_t draw_width = m_draw_x_extent - m_draw_x;
-
-        if (m_flags & PRIM_FLAGS_ALL_SAME) {
-          paint_fcn->copy_line_as_outer_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, m_transparent_color, src_pixels);          
-        } else {
-          uint32_t at_jump_table = paint_fcn->init_jump_table(m_save_height);
-          for (uint32_t line = 0; line < m_save_height; line++) {
-            paint_fcn->align32();
-            paint_fcn->j_to_here(at_jump_table + line * sizeof(uint32_t));
-            paint_fcn->copy_line_as_inner_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, m_transparent_color, src_pixels);
-            src_pixels += m_words_per_line;
-          }
+    uint32_t draw_width = m_draw_x_extent - m_draw_x;
+    uint32_t src_x = m_draw_x - m_abs_x;
+    if (m_flip & BITMAP_FLIP_H) {
+      generate_mirrored_paint_fcns(m_paint_fcn, src_x, draw_width);
+    } else if (src_x == 0 && draw_width == (uint32_t)m_width &&
+        ((m_flags & PRIM_FLAG_H_SCROLL_1) || !(m_draw_x & 3))) {
+      // The whole width is drawn, so the code is the same for every bitmap using the asset.
+      auto shared_fcns = m_asset->get_paint_fcns();
+      if (!m_asset->is_code_valid()) {
+        for (uint32_t pos = 0; pos < 4; pos++) {
+          shared_fcns[pos].clear();
         }
-        paint_fcn->do_fixups(fixups);
+        generate_paint_fcns(shared_fcns, src_x, draw_width);
+        m_asset->set_code_valid(true);
       }
+      m_paint_fcns = shared_fcns;
     } else {
-      // Bitmap must be positioned on a 4-byte boundary (pixel offset 0)!
+      generate_paint_fcns(m_paint_fcn, src_x, draw_width);
+    }
+  } else {
+    for (uint32_t pos = 0; pos < 4; pos++) {
+      m_paint_fcn[pos].enter_and_leave_outer_function();
+    }
+  }
+  //debug_log(" @%i ",__LINE__);
+}
+
+void IRAM_ATTR DiBitmap::generate_paint_fcns(EspFunction* paint_fcns, uint32_t src_x, uint32_t draw_width) {
+  auto transparent_color = m_asset->get_transparent_color();
+  if (m_flags & PRIM_FLAG_H_SCROLL_1) {
+    // Bitmap can be positioned on any horizontal byte boundary (pixel offsets 0..3).
+    // The code for each offset shifts the pixels, starting at the first visible column.
+    for (uint32_t pos = 0; pos < 4; pos++) {
       EspFixups fixups;
-      EspFunction* paint_fcn = &m_paint_fcn[0];
-      uint32_t draw_width = m_draw_x_extent - m_draw_x;
+      EspFunction* paint_fcn = &paint_fcns[pos];
       uint32_t* src_pixels = m_pixels;
+      uint32_t x = (m_draw_x & 0xFFFFFFFC) | pos;
 
       if (m_flags & PRIM_FLAGS_ALL_SAME) {
-        paint_fcn->copy_line_as_outer_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, m_transparent_color, src_pixels);          
+        paint_fcn->copy_shifted_line_as_outer_fcn(fixups, m_draw_x, x, draw_width, m_flags, transparent_color, src_pixels, src_x);
       } else {
         uint32_t at_jump_table = paint_fcn->init_jump_table(m_save_height);
         for (uint32_t line = 0; line < m_save_height; line++) {
           paint_fcn->align32();
           paint_fcn->j_to_here(at_jump_table + line * sizeof(uint32_t));
-          paint_fcn->copy_line_as_inner_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, m_transparent_color, src_pixels);
+          paint_fcn->copy_shifted_line_as_inner_fcn(fixups, m_draw_x, x, draw_width, m_flags, transparent_color, src_pixels, src_x);
           src_pixels += m_words_per_line;
         }
       }
       paint_fcn->do_fixups(fixups);
     }
   } else {
-    if (m_flags & PRIM_FLAG_H_SCROLL_1) {
-      for (uint32_t pos = 0; pos < 4; pos++) {
-        m_paint_fcn[pos].enter_and_leave_outer_function();
+    // Bitmap must be positioned on a 4-byte boundary (pixel offset 0)!
+    EspFixups fixups;
+    EspFunction* paint_fcn = &paint_fcns[0];
+    uint32_t* src_pixels = m_pixels;
+
+    if (m_flags & PRIM_FLAGS_ALL_SAME) {
+      paint_fcn->copy_line_as_outer_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, transparent_color, src_pixels);          
+    } else {
+      uint32_t at_jump_table = paint_fcn->init_jump_table(m_save_height);
+      for (uint32_t line = 0; line < m_save_height; line++) {
+        paint_fcn->align32();
+        paint_fcn->j_to_here(at_jump_table + line * sizeof(uint32_t));
+        paint_fcn->copy_line_as_inner_fcn(fixups, m_draw_x, m_draw_x, draw_width, m_flags, transparent_color, src_pixels);
+        src_pixels += m_words_per_line;
       }
+    }
+    paint_fcn->do_fixups(fixups);
+  }
+}
+
+void IRAM_ATTR DiBitmap::generate_mirrored_paint_fcns(EspFunction* paint_fcns, uint32_t src_x, uint32_t draw_width) {
+  // The first drawn pixel comes from the mirrored source column.
+  auto transparent_color = m_asset->get_transparent_color();
+  uint32_t src_col = get_source_column(src_x);
+  uint32_t num_positions = (m_flags & PRIM_FLAG_H_SCROLL_1) ? 4 : 1;
+  for (uint32_t pos = 0; pos < num_positions; pos++) {
+    EspFixups fixups;
+    EspFunction* paint_fcn = &paint_fcns[pos];
+    uint32_t* src_pixels = m_pixels;
+    uint32_t x = (m_draw_x & 0xFFFFFFFC) | pos;
+
+    if (m_flags & PRIM_FLAGS_ALL_SAME) {
+      paint_fcn->copy_mirrored_line_as_outer_fcn(fixups, m_draw_x, x, draw_width, m_flags, transparent_color, src_pixels, src_col);
     } else {
-      m_paint_fcn[0].enter_and_leave_outer_function();
+      uint32_t at_jump_table = paint_fcn->init_jump_table(m_save_height);
+      for (uint32_t line = 0; line < m_save_height; line++) {
+        paint_fcn->align32();
+        paint_fcn->j_to_here(at_jump_table + line * sizeof(uint32_t));
+        paint_fcn->copy_mirrored_line_as_inner_fcn(fixups, m_draw_x, x, draw_width, m_flags, transparent_color, src_pixels, src_col);
+        src_pixels += m_words_per_line;
+      }
     }
+    paint_fcn->do_fixups(fixups);
   }
-  //debug_log(" @%i ",__LINE__);
 }
 
 void IRAM_ATTR DiBitmap::paint(volatile uint32_t* p_scan_line, uint32_t line_index) {
-  auto y_offset_within_bitmap = (int32_t)line_index - m_abs_y;
+  auto y_offset_within_bitmap = get_source_row(line_index);
   auto src_pixels = m_visible_start + y_offset_within_bitmap * m_words_per_line;
-  m_paint_fcn[m_draw_x & 3].call_a5_a6(this, p_scan_line, line_index, m_draw_x, (uint32_t)src_pixels);
+  if (m_line_cache) {
+    // Normally the line was prefetched; if not (e.g., the bitmap just moved), it is copied now.
+    src_pixels = get_cached_line(line_index, src_pixels);
+  }
+  if ((m_flip & BITMAP_FLIP_H) && (m_draw_x & 3) && !(m_flags & PRIM_FLAG_H_SCROLL_1)) {
+    paint_mirrored_line((uint8_t*)p_scan_line, (const uint8_t*)src_pixels);
+    return;
+  }
+  // The line index selects the per-line code (in the jump table) for the line within the whole
+  // bitmap, so that each slice uses the code that was built for its own pixels.
+  m_paint_fcns[m_draw_x & 3].call_a5_a6(this, p_scan_line,
+    m_abs_y + y_offset_within_bitmap + m_visible_line, m_draw_x, (uint32_t)src_pixels);
+}
+
+void IRAM_ATTR DiBitmap::paint_mirrored_line(uint8_t* line_bytes, const uint8_t* src_bytes) {
+  // As in the generated code, only a blended bitmap skips transparent pixels;
+  // otherwise, every pixel is copied as it is.
+  auto transparent_color = m_asset->get_transparent_color();
+  bool blended = (m_flags & PRIM_FLAGS_BLENDED) != 0;
+  int32_t col = get_source_column(m_draw_x - m_abs_x);
+  for (int32_t x = m_draw_x; x < m_draw_x_extent; x++) {
+    uint8_t color = src_bytes[FIX_INDEX(col--)];
+    if (blended && color == transparent_color) {
+      continue;
+    }
+    if (blended && (color & 0xC0)) {
+      line_bytes[FIX_INDEX(x)] = blend_pixel(line_bytes[FIX_INDEX(x)], color);
+    } else {
+      line_bytes[FIX_INDEX(x)] = color;
+    }
+  }
 }
@@ -33,12 +33,76 @@
 #include "di_primitive.h"
 #include "di_code.h"
 
+#define BITMAP_ANIM_LOOP      0x00  // after the last frame, go back to the first frame
+#define BITMAP_ANIM_PING_PONG 0x01  // after the last frame, step backward to the first frame
+
+#define BITMAP_CODE_LITERAL   0x00  // token 00..7F: 1..128 literal colors follow
+#define BITMAP_CODE_RUN       0x80  // token 80..BF: 2..65 copies of the following color
+#define BITMAP_CODE_COPY      0xC0  // token C0..FF: 3..66 pixels copied from a 16-bit distance back
+
+// Flags that affect the paint code, which must be the same for all bitmaps sharing an asset
+#define BITMAP_SHARED_FLAGS   (PRIM_FLAG_H_SCROLL_1|PRIM_FLAGS_MASKED|PRIM_FLAGS_BLENDED|PRIM_FLAGS_ALL_SAME|PRIM_FLAGS_X_SRC)
+
+#define BITMAP_MEMORY_INTERNAL 0x00 // keep the pixels in internal RAM
+#define BITMAP_MEMORY_PSRAM    0x01 // keep the pixels in PSRAM, caching upcoming lines in internal RAM
+
+#define BITMAP_FLIP_H         0x01  // mirror the pixels left-to-right
+#define BITMAP_FLIP_V         0x02  // mirror the pixels top-to-bottom
+
+#define BITMAP_CACHE_LINES    16    // number of lines cached for a PSRAM bitmap (must be a power of 2)
+
+// The pixel data of a bitmap, shared by the bitmap and by any bitmaps that reference it,
+// along with paint code that all of them may use when they are not clipped horizontally.
+// The asset is reference counted, and is destroyed when the last bitmap using it is destroyed,
+// so deleting the original bitmap does not affect the bitmaps that reference it.
+class DiBitmapAsset {
+  public:
+  // Construct an asset with cleared pixels, kept in the given type of memory.
+  DiBitmapAsset(uint32_t bytes, uint8_t memory);
+
+  // Destroy an asset.
+  ~DiBitmapAsset();
+
+  // Add a user of the asset.
+  inline void add_ref() { m_ref_count++; }
+
+  // Remove a user of the asset, destroying the asset if it has no more users.
+  void release();
+
+  // Get the pixel data.
+  inline uint32_t* get_pixels() { return m_pixels; }
+
+  // Determine whether the pixel data is in PSRAM.
+  inline bool is_in_psram() { return m_in_psram; }
+
+  // Get or set the color value that represents a transparent pixel (with inverted alpha bits).
+  inline uint8_t get_transparent_color() { return m_transparent_color; }
+  inline void set_transparent_color(uint8_t color) { m_transparent_color = color; m_code_valid = false; }
+
+  // Get the shared paint code, for drawing the full width of the bitmap.
+  inline EspFunction* get_paint_fcns() { return m_paint_fcn; }
+
+  // Determine whether the shared paint code matches the pixel data.
+  inline bool is_code_valid() { return m_code_valid; }
+
+  // Mark the shared paint code as matching (or not matching) the pixel data.
+  inline void set_code_valid(bool valid) { m_code_valid = valid; }
+
+  protected:
+  uint32_t    m_ref_count;
+  uint32_t*   m_pixels;
+  EspFunction m_paint_fcn[4];
+  bool        m_in_psram;
+  bool        m_code_valid;
+  uint8_t     m_transparent_color;
+};
+
 class DiBitmap : public DiPrimitive {
   public:
-  // Construct a bitmap that owns its pixel data.
-  DiBitmap(uint32_t width, uint32_t height, uint16_t flags);
+  // Construct a bitmap that owns its pixel data, kept in the given type of memory.
+  DiBitmap(uint32_t width, uint32_t height, uint16_t flags, uint8_t memory);
 
-  // Construct a bitmap that references (borrows) its pixel data.
+  // Construct a bitmap that references (shares) the pixel data of another bitmap.
   DiBitmap(uint16_t flags, DiBitmap* ref_bitmap);
 
   // Destroy a bitmap.
@@ -51,6 +115,42 @@ class DiBitmap : public DiPrimitive {
   // This makes it possible to use a single (tall) bitmap to support animated sprites.
   void IRAM_ATTR set_slice_position(int32_t x, int32_t y, uint32_t start_line, uint32_t height);
 
+  // Setup automatic animation through frames that are stacked vertically in the bitmap.
+  // Each frame is the given number of lines high, and the visible frame changes once
+  // per the given number of video frames. Using fewer than 2 frames stops the animation.
+  void set_animation(uint32_t frame_height, uint32_t num_frames, uint32_t frames_per_step, uint8_t mode);
+
+  // Advance the animation by one video frame. Returns true if the visible frame changed.
+  bool IRAM_ATTR animate();
+
+  // Show the pixels starting at the given line in the bitmap, without changing the position
+  // or height of the visible slice, nor the paint groups. The line is ignored if the slice
+  // would extend past the bottom of the bitmap.
+  virtual void IRAM_ATTR set_visible_line(uint32_t start_line);
+
+  // Get this primitive as a bitmap.
+  virtual DiBitmap* as_bitmap();
+
+  // Determine whether the bitmap is animating automatically.
+  inline bool is_animated() { return m_anim_frames > 1; }
+
+  // Set or get the flip mode (BITMAP_FLIP_H and/or BITMAP_FLIP_V). Flipping does not change
+  // the pixel data, so bitmaps referencing the same pixels may each be flipped differently.
+  void set_flip(uint8_t flip);
+  inline uint8_t get_flip() { return m_flip; }
+
+  // Get the shared pixel data.
+  inline DiBitmapAsset* get_asset() { return m_asset; }
+
+  // Determine whether the pixels are kept in PSRAM (and painted from the line cache).
+  inline bool is_in_psram() { return m_line_cache != NULL; }
+
+  // Forget the cached lines, and prefetch the first lines of the next frame.
+  void IRAM_ATTR start_line_cache();
+
+  // Copy the pixels for screen lines up to (not including) the given line into the line cache.
+  void IRAM_ATTR prefetch_lines(int32_t end_line_index);
+
   // Set a single pixel within the allocated bitmap. The upper 2 bits of the color
   // are the transparency level (00BBGGRR is 25% opaque, 01BBGGRR is 50% opaque,
   // 10BBGGRR is 75% opaque, and 11BBGGRR is 100% opaque). If the given color value
@@ -58,6 +158,17 @@ class DiBitmap : public DiPrimitive {
   // meaning 0% opaque.
   void set_transparent_pixel(int32_t x, int32_t y, uint8_t color);
 
+  // Get the color of a single pixel within the allocated bitmap, with normal alpha bits
+  // (as given when the pixel was set).
+  inline uint8_t get_pixel(int32_t x, int32_t y) {
+    return PIXEL_ALPHA_INV_MASK(((uint8_t*)(m_pixels + y * m_words_per_line))[FIX_INDEX(x)]);
+  }
+
+  // Decode compressed pixel data (RLE and LZ77 tokens) into the bitmap, starting at the given
+  // position, and continuing in row-major order, as with setting individual pixels.
+  // Decoding stops at the end of the data or at the end of the bitmap.
+  void decode_pixels(int32_t x, int32_t y, const uint8_t* data, uint32_t size);
+
   // Set the single 8-bit color value used to represent a transparent pixel. This should be
   // an unused color value in the visible image when designing the image. This does take out
   // 1 of the 256 possible color values. The upper 2 bits of the color are the transparency
@@ -65,6 +176,12 @@ class DiBitmap : public DiPrimitive {
   // 11BBGGRR is 100% opaque).
   void set_transparent_color(uint8_t color);
 
+  // Get the horizontal span of pixels that are painted fully opaque on the given line.
+  virtual bool get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent);
+
+  // Find the first run of drawn (not fully transparent) pixels on the given line, within the given span.
+  virtual bool find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent);
+
   // Clear the custom instructions needed to draw the primitive.
   virtual void IRAM_ATTR delete_instructions();
    
@@ -77,14 +194,58 @@ class DiBitmap : public DiPrimitive {
   // Set a single pixel with an adjusted color value.
   void set_pixel(int32_t x, int32_t y, uint8_t color);
 
+  // Generate paint code for drawing the given part of each line, at the current position.
+  void IRAM_ATTR generate_paint_fcns(EspFunction* paint_fcns, uint32_t src_x, uint32_t draw_width);
+
+  // Set a run of pixels to the same adjusted color value, within a single line.
+  void fill_span(uint8_t* line_bytes, int32_t x, int32_t count, uint8_t color);
+
+  // Get the line within the visible slice that is drawn on the given screen line.
+  inline int32_t get_source_row(int32_t line_index) {
+    int32_t y = line_index - m_abs_y;
+    return (m_flip & BITMAP_FLIP_V) ? m_height - 1 - y : y;
+  }
+
+  // Get the column within the bitmap that is drawn at the given column of the bitmap's area.
+  inline int32_t get_source_column(int32_t col) {
+    return (m_flip & BITMAP_FLIP_H) ? m_width - 1 - col : col;
+  }
+
+  // Generate paint code for drawing the given part of each line mirrored left-to-right.
+  // This code is never shared, because each bitmap using the asset may be flipped differently.
+  void IRAM_ATTR generate_mirrored_paint_fcns(EspFunction* paint_fcns, uint32_t src_x, uint32_t draw_width);
+
+  // Draw one line mirrored left-to-right, without generated code. This is only used when
+  // the bitmap is not on a word boundary, and has no code for the other pixel offsets.
+  void IRAM_ATTR paint_mirrored_line(uint8_t* line_bytes, const uint8_t* src_bytes);
+
+  // Allocate the internal RAM used to cache lines of PSRAM pixels.
+  void create_line_cache();
+
+  // Get an internal RAM copy of the source pixels for the given screen line.
+  uint32_t* IRAM_ATTR get_cached_line(int32_t line_index, uint32_t* src_pixels);
+
   uint32_t    m_words_per_line;
   uint32_t    m_bytes_per_line;
   uint32_t    m_words_per_position;
   uint32_t    m_bytes_per_position;
   uint32_t*   m_visible_start;
+  uint32_t    m_visible_line;
   uint32_t*   m_pixels;
+  DiBitmapAsset* m_asset;
+  EspFunction* m_paint_fcns;
+  uint32_t*   m_line_cache;
+  uint32_t**  m_cache_tags;
+  int32_t     m_prefetch_line;
   uint32_t    m_save_height;
   uint32_t    m_built_width;
   EspFunction m_paint_fcn[4];
-  uint8_t     m_transparent_color;
+  uint16_t    m_anim_frame_height;
+  uint16_t    m_anim_frames;
+  uint16_t    m_anim_frame;
+  uint16_t    m_anim_frames_per_step;
+  uint16_t    m_anim_countdown;
+  int8_t      m_anim_direction;
+  uint8_t     m_anim_mode;
+  uint8_t     m_flip;
 };
@@ -1190,6 +1190,463 @@ void EspFunction::copy_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x,
     }
 }
 
+void EspFunction::copy_shifted_line_as_outer_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+    auto at_jump = enter_outer_function();
+    auto at_data = begin_data();
+
+    uint32_t at_src = 0;
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        at_src = d32((uint32_t)src_pixels);
+    }
+
+    uint32_t at_isolate_br = 0;
+    uint32_t at_isolate_g = 0;
+    if (flags & PRIM_FLAGS_BLENDED) {
+        at_isolate_br = d32(MASK_ISOLATE_BR); // mask to isolate blue & red, removing green
+        at_isolate_g = d32(MASK_ISOLATE_G); // mask to isolate green, removing red & blue
+    }
+
+    begin_code(at_jump);
+    set_reg_dst_pixel_ptr_for_copy(flags);
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        l32r_from(REG_SRC_PIXEL_PTR, at_src);
+    }
+
+    if (flags & PRIM_FLAGS_BLENDED) {
+        l32r_from(REG_ISOLATE_BR, at_isolate_br);
+        l32r_from(REG_ISOLATE_G, at_isolate_g);
+    }
+
+    s32i(REG_RETURN_ADDR, REG_STACK_PTR, OUTER_RET_ADDR_IN_STACK);
+    copy_shifted_line_loop(fixups, draw_x, x, width, flags, transparent_color, src_pixels, src_x);
+    l32i(REG_RETURN_ADDR, REG_STACK_PTR, OUTER_RET_ADDR_IN_STACK);
+    retw();
+}
+
+void EspFunction::copy_shifted_line_as_inner_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+    auto at_jump = enter_inner_function();
+    auto at_data = begin_data();
+
+    uint32_t at_src = 0;
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        at_src = d32((uint32_t)src_pixels);
+    }
+
+    uint32_t at_isolate_br = 0;
+    uint32_t at_isolate_g = 0;
+    if (flags & PRIM_FLAGS_BLENDED) {
+        at_isolate_br = d32(MASK_ISOLATE_BR); // mask to isolate blue & red, removing green
+        at_isolate_g = d32(MASK_ISOLATE_G); // mask to isolate green, removing red & blue
+    }
+
+    begin_code(at_jump);
+
+    set_reg_dst_pixel_ptr_for_copy(flags);
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        l32r_from(REG_SRC_PIXEL_PTR, at_src);
+    }
+
+    if (flags & PRIM_FLAGS_BLENDED) {
+        l32r_from(REG_ISOLATE_BR, at_isolate_br);
+        l32r_from(REG_ISOLATE_G, at_isolate_g);
+    }
+
+    s32i(REG_RETURN_ADDR, REG_STACK_PTR, INNER_RET_ADDR_IN_STACK);
+    copy_shifted_line_loop(fixups, draw_x, x, width, flags, transparent_color, src_pixels, src_x);
+    l32i(REG_RETURN_ADDR, REG_STACK_PTR, INNER_RET_ADDR_IN_STACK);
+    ret();
+}
+
+// Get the opaqueness of a source pixel, given its index within the line.
+static uint8_t get_opaqueness(uint8_t* p_src_bytes, uint32_t index, uint16_t flags, uint8_t transparent_color) {
+    if (!(flags & PRIM_FLAGS_BLENDED)) {
+        return 100;
+    }
+    uint8_t src_color = p_src_bytes[FIX_OFFSET(index)];
+    if (src_color == transparent_color) {
+        return 0;
+    }
+    // This tests using inverted alpha masks.
+    switch (src_color & 0xC0) {
+        case PIXEL_ALPHA_INV_25_MASK: return 25;
+        case PIXEL_ALPHA_INV_50_MASK: return 50;
+        case PIXEL_ALPHA_INV_75_MASK: return 75;
+        default: return 100;
+    }
+}
+
+// Copies pixels from a single (unshifted) copy of the source line, where the first
+// source pixel is at src_x, to the destination line, where the first destination
+// pixel is at x. When the two are not at the same offset within a word, each
+// destination word is built from 2 source words, using funnel shifts.
+//
+// Registers used:
+// a4  = previous source word (the line index is no longer needed)
+// a10 = temporary value, or loop count
+// a11 = next source word
+// a15 = shifted pixels for 1 destination word (REG_SAVE_COLOR, as used by color blending)
+//
+void EspFunction::copy_shifted_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+
+    // Point to the source word that holds the first source pixel.
+    auto src_word_x = src_x & 0xFFFFFFFC;
+    add_to_reg(REG_SRC_PIXEL_PTR, src_word_x);
+    auto src_offset = src_x & 3;
+    auto dst_offset = x & 3;
+
+    if (src_offset == dst_offset) {
+        // The pixels line up within words, just as with a pre-shifted copy.
+        copy_line_loop(fixups, draw_x, x, width, flags, transparent_color, src_pixels + src_word_x / 4);
+        return;
+    }
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        adjust_dst_pixel_ptr(draw_x, x);
+    }
+
+    // Pixel N of destination word K comes from pixel (N + delta) of source word K,
+    // or from pixel (N + delta - 4) of source word K+1.
+    uint32_t delta;
+    if (src_offset > dst_offset) {
+        delta = src_offset - dst_offset;
+    } else {
+        delta = src_offset + 4 - dst_offset;
+        add_to_reg(REG_SRC_PIXEL_PTR, -4);
+    }
+
+    auto p_src_bytes = (uint8_t*) src_pixels;
+    ssai(16);
+    auto num_words = (dst_offset + width + 3) / 4;
+    auto last_pos = (dst_offset + width - 1) & 3;
+    bool have_prev = false;
+    uint32_t pending = 0; // bytes to advance both pointers, before using them
+
+    for (uint32_t k = 0; k < num_words; k++) {
+        uint32_t first = (k ? 0 : dst_offset);
+        uint32_t last = ((k == num_words - 1) ? last_pos : 3);
+
+        if (!(flags & PRIM_FLAGS_BLENDED) && k == 1 && num_words > 3) {
+            // Copy the full words in the middle of the line using a loop.
+            add_to_reg(REG_SRC_PIXEL_PTR, pending);
+            add_to_reg(REG_DST_PIXEL_PTR, pending);
+            pending = 0;
+            movi(a10, num_words - 2);
+            auto at_loop = get_code_index();
+            loop(a10, 0);
+            shift_word_for_copy(delta, !have_prev, true);
+            s32i(a15, REG_DST_PIXEL_PTR, 0);
+            addi(REG_SRC_PIXEL_PTR, REG_SRC_PIXEL_PTR, 4);
+            addi(REG_DST_PIXEL_PTR, REG_DST_PIXEL_PTR, 4);
+            loop_to_here(a10, at_loop);
+            have_prev = true;
+            k = num_words - 2;
+            continue;
+        }
+
+        // Determine which pixels in this word are visible at all.
+        bool visible = false;
+        for (uint32_t pos = first; pos <= last; pos++) {
+            if (get_opaqueness(p_src_bytes, src_x + k * 4 + pos - dst_offset, flags, transparent_color)) {
+                visible = true;
+                break;
+            }
+        }
+
+        if (visible) {
+            add_to_reg(REG_SRC_PIXEL_PTR, pending);
+            add_to_reg(REG_DST_PIXEL_PTR, pending);
+            pending = 0;
+
+            bool need_prev = (first + delta < 4);
+            bool need_next = (last + delta > 3);
+            shift_word_for_copy(delta, need_prev && !have_prev, need_next);
+            have_prev = need_next;
+
+            // Write runs of similarly transparent (or opaque) pixels.
+            uint32_t pos = first;
+            while (pos <= last) {
+                auto opaqueness = get_opaqueness(p_src_bytes, src_x + k * 4 + pos - dst_offset, flags, transparent_color);
+                uint32_t run = 1;
+                while (pos + run <= last &&
+                        get_opaqueness(p_src_bytes, src_x + k * 4 + pos + run - dst_offset, flags, transparent_color) == opaqueness) {
+                    run++;
+                }
+
+                if (opaqueness == 100) {
+                    store_shifted_pixels(pos, pos + run - 1);
+                } else if (opaqueness) {
+                    // The blending functions take the source pixels from REG_SAVE_COLOR.
+                    uint32_t p_fcn = 0;
+                    switch (opaqueness * 16 + run * 4 + pos) {
+                        case 25*16+1*4+0: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_0_last; break;
+                        case 25*16+1*4+1: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_1_last; break;
+                        case 25*16+1*4+2: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_2_last; break;
+                        case 25*16+1*4+3: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_3_last; break;
+                        case 25*16+2*4+0: p_fcn = (uint32_t) &fcn_color_blend_25_for_2_pixels_at_offset_0_last; break;
+                        case 25*16+2*4+1: p_fcn = (uint32_t) &fcn_color_blend_25_for_2_pixels_at_offset_1_last; break;
+                        case 25*16+2*4+2: p_fcn = (uint32_t) &fcn_color_blend_25_for_2_pixels_at_offset_2_last; break;
+                        case 25*16+3*4+0: p_fcn = (uint32_t) &fcn_color_blend_25_for_3_pixels_at_offset_0_last; break;
+                        case 25*16+3*4+1: p_fcn = (uint32_t) &fcn_color_blend_25_for_3_pixels_at_offset_1_last; break;
+                        case 25*16+4*4+0: p_fcn = (uint32_t) &fcn_color_blend_25_for_4_pixels_at_offset_0_last; break;
+                        case 50*16+1*4+0: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_0_last; break;
+                        case 50*16+1*4+1: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_1_last; break;
+                        case 50*16+1*4+2: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_2_last; break;
+                        case 50*16+1*4+3: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_3_last; break;
+                        case 50*16+2*4+0: p_fcn = (uint32_t) &fcn_color_blend_50_for_2_pixels_at_offset_0_last; break;
+                        case 50*16+2*4+1: p_fcn = (uint32_t) &fcn_color_blend_50_for_2_pixels_at_offset_1_last; break;
+                        case 50*16+2*4+2: p_fcn = (uint32_t) &fcn_color_blend_50_for_2_pixels_at_offset_2_last; break;
+                        case 50*16+3*4+0: p_fcn = (uint32_t) &fcn_color_blend_50_for_3_pixels_at_offset_0_last; break;
+                        case 50*16+3*4+1: p_fcn = (uint32_t) &fcn_color_blend_50_for_3_pixels_at_offset_1_last; break;
+                        case 50*16+4*4+0: p_fcn = (uint32_t) &fcn_color_blend_50_for_4_pixels_at_offset_0_last; break;
+                        case 75*16+1*4+0: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_0_last; break;
+                        case 75*16+1*4+1: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_1_last; break;
+                        case 75*16+1*4+2: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_2_last; break;
+                        case 75*16+1*4+3: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_3_last; break;
+                        case 75*16+2*4+0: p_fcn = (uint32_t) &fcn_color_blend_75_for_2_pixels_at_offset_0_last; break;
+                        case 75*16+2*4+1: p_fcn = (uint32_t) &fcn_color_blend_75_for_2_pixels_at_offset_1_last; break;
+                        case 75*16+2*4+2: p_fcn = (uint32_t) &fcn_color_blend_75_for_2_pixels_at_offset_2_last; break;
+                        case 75*16+3*4+0: p_fcn = (uint32_t) &fcn_color_blend_75_for_3_pixels_at_offset_0_last; break;
+                        case 75*16+3*4+1: p_fcn = (uint32_t) &fcn_color_blend_75_for_3_pixels_at_offset_1_last; break;
+                        case 75*16+4*4+0: p_fcn = (uint32_t) &fcn_color_blend_75_for_4_pixels_at_offset_0_last; break;
+                    }
+                    fixups.push_back(EspFixup { get_code_index(), p_fcn });
+                    call0(0);
+                }
+                pos += run;
+            }
+        } else {
+            // Nothing to draw in this word, so the previous source word must be reloaded later.
+            have_prev = false;
+        }
+        pending += 4;
+    }
+}
+
+void EspFunction::copy_mirrored_line_as_outer_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+    auto at_jump = enter_outer_function();
+    auto at_data = begin_data();
+
+    uint32_t at_src = 0;
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        at_src = d32((uint32_t)src_pixels);
+    }
+
+    uint32_t at_isolate_br = 0;
+    uint32_t at_isolate_g = 0;
+    if (flags & PRIM_FLAGS_BLENDED) {
+        at_isolate_br = d32(MASK_ISOLATE_BR); // mask to isolate blue & red, removing green
+        at_isolate_g = d32(MASK_ISOLATE_G); // mask to isolate green, removing red & blue
+    }
+
+    begin_code(at_jump);
+    set_reg_dst_pixel_ptr_for_copy(flags);
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        l32r_from(REG_SRC_PIXEL_PTR, at_src);
+    }
+
+    if (flags & PRIM_FLAGS_BLENDED) {
+        l32r_from(REG_ISOLATE_BR, at_isolate_br);
+        l32r_from(REG_ISOLATE_G, at_isolate_g);
+    }
+
+    s32i(REG_RETURN_ADDR, REG_STACK_PTR, OUTER_RET_ADDR_IN_STACK);
+    copy_mirrored_line_loop(fixups, draw_x, x, width, flags, transparent_color, src_pixels, src_x);
+    l32i(REG_RETURN_ADDR, REG_STACK_PTR, OUTER_RET_ADDR_IN_STACK);
+    retw();
+}
+
+void EspFunction::copy_mirrored_line_as_inner_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+    auto at_jump = enter_inner_function();
+    auto at_data = begin_data();
+
+    uint32_t at_src = 0;
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        at_src = d32((uint32_t)src_pixels);
+    }
+
+    uint32_t at_isolate_br = 0;
+    uint32_t at_isolate_g = 0;
+    if (flags & PRIM_FLAGS_BLENDED) {
+        at_isolate_br = d32(MASK_ISOLATE_BR); // mask to isolate blue & red, removing green
+        at_isolate_g = d32(MASK_ISOLATE_G); // mask to isolate green, removing red & blue
+    }
+
+    begin_code(at_jump);
+
+    set_reg_dst_pixel_ptr_for_copy(flags);
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        l32r_from(REG_SRC_PIXEL_PTR, at_src);
+    }
+
+    if (flags & PRIM_FLAGS_BLENDED) {
+        l32r_from(REG_ISOLATE_BR, at_isolate_br);
+        l32r_from(REG_ISOLATE_G, at_isolate_g);
+    }
+
+    s32i(REG_RETURN_ADDR, REG_STACK_PTR, INNER_RET_ADDR_IN_STACK);
+    copy_mirrored_line_loop(fixups, draw_x, x, width, flags, transparent_color, src_pixels, src_x);
+    l32i(REG_RETURN_ADDR, REG_STACK_PTR, INNER_RET_ADDR_IN_STACK);
+    ret();
+}
+
+// Copies pixels from a source line to the destination line in reverse order, for a
+// horizontally flipped bitmap. The first destination pixel (at x) comes from source
+// pixel src_x, the next one from source pixel src_x - 1, and so on. Reversing the
+// pixels of a word takes as many instructions as moving them one at a time, so each
+// visible pixel is a byte load and store, and transparent pixels cost nothing.
+//
+// Registers used:
+// a7  = pixel being copied (REG_PIXEL_COLOR)
+// a15 = pixel being blended, at its position in the destination word (REG_SAVE_COLOR)
+//
+void EspFunction::copy_mirrored_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x) {
+
+    if (!(flags & PRIM_FLAGS_X_SRC)) {
+        adjust_dst_pixel_ptr(draw_x, x);
+    }
+
+    auto p_src_bytes = (uint8_t*) src_pixels;
+    uint32_t src_base = 0; // bytes added to the source pointer so far
+    uint32_t pending = 0; // bytes to advance the destination pointer, before using it
+    uint32_t pos = x & 3;
+    int32_t col = src_x;
+
+    while (width--) {
+        auto opaqueness = get_opaqueness(p_src_bytes, col, flags, transparent_color);
+        if (opaqueness) {
+            // Keep the source byte within reach of a load offset (0..255). The source
+            // pointer only moves toward lower columns, and stays word aligned.
+            uint32_t src_byte = FIX_OFFSET(col);
+            if (src_byte < src_base || src_byte > src_base + 255) {
+                uint32_t new_base = (src_byte > 252 ? (src_byte & 0xFFFFFFFC) - 252 : 0);
+                add_to_reg(REG_SRC_PIXEL_PTR, (int32_t)new_base - (int32_t)src_base);
+                src_base = new_base;
+            }
+            add_to_reg(REG_DST_PIXEL_PTR, pending);
+            pending = 0;
+
+            if (opaqueness == 100) {
+                l8ui(REG_PIXEL_COLOR, REG_SRC_PIXEL_PTR, src_byte - src_base);
+                s8i(REG_PIXEL_COLOR, REG_DST_PIXEL_PTR, FIX_OFFSET(pos));
+            } else {
+                // The blending functions take the source pixels from REG_SAVE_COLOR.
+                l8ui(REG_SAVE_COLOR, REG_SRC_PIXEL_PTR, src_byte - src_base);
+                if (FIX_OFFSET(pos)) {
+                    slli(REG_SAVE_COLOR, REG_SAVE_COLOR, FIX_OFFSET(pos) * 8);
+                }
+                uint32_t p_fcn = 0;
+                switch (opaqueness * 4 + pos) {
+                    case 25*4+0: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_0_last; break;
+                    case 25*4+1: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_1_last; break;
+                    case 25*4+2: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_2_last; break;
+                    case 25*4+3: p_fcn = (uint32_t) &fcn_color_blend_25_for_1_pixel_at_offset_3_last; break;
+                    case 50*4+0: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_0_last; break;
+                    case 50*4+1: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_1_last; break;
+                    case 50*4+2: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_2_last; break;
+                    case 50*4+3: p_fcn = (uint32_t) &fcn_color_blend_50_for_1_pixel_at_offset_3_last; break;
+                    case 75*4+0: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_0_last; break;
+                    case 75*4+1: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_1_last; break;
+                    case 75*4+2: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_2_last; break;
+                    case 75*4+3: p_fcn = (uint32_t) &fcn_color_blend_75_for_1_pixel_at_offset_3_last; break;
+                }
+                fixups.push_back(EspFixup { get_code_index(), p_fcn });
+                call0(0);
+            }
+        }
+        col--;
+        if (++pos == 4) {
+            pos = 0;
+            pending += 4;
+        }
+    }
+}
+
+void EspFunction::add_to_reg(reg_t reg, int32_t value) {
+    while (value) {
+        int32_t step = MAX(MIN(value, 120), -128);
+        addi(reg, reg, step);
+        value -= step;
+    }
+}
+
+// Builds 1 destination word of pixels in a15, from the previous source word (a4)
+// and the next source word (a11), with SAR holding 16 before and after. Source words
+// are kept in their original order when the shift is 2 pixels, because swapping
+// the 16-bit halves of a word swaps pairs of pixels (see FIX_OFFSET). Otherwise,
+// they are kept with their halves swapped (i.e., with pixels in natural order).
+void EspFunction::shift_word_for_copy(uint32_t delta, bool load_prev, bool load_next) {
+    if (load_prev) {
+        l32i(a4, REG_SRC_PIXEL_PTR, 0);
+        if (delta != 2) {
+            src(a4, a4, a4);
+        }
+    }
+    if (load_next) {
+        l32i(a11, REG_SRC_PIXEL_PTR, 4);
+        if (delta != 2) {
+            src(a11, a11, a11);
+        }
+    }
+    if (delta == 2) {
+        src(a15, a4, a11);
+    } else {
+        ssai(delta * 8);
+        src(a15, a11, a4);
+        ssai(16);
+        src(a15, a15, a15);
+    }
+    if (load_next) {
+        mov(a4, a11);
+    }
+}
+
+// Stores pixels from a15 into the destination word, from first_pos to last_pos,
+// with SAR holding 16.
+void EspFunction::store_shifted_pixels(uint32_t first_pos, uint32_t last_pos,
+        reg_t src_reg, reg_t dst_reg, u_off_t offset) {
+    if (first_pos == 0 && last_pos == 3) {
+        s32i(src_reg, dst_reg, offset);
+        return;
+    }
+    if (first_pos <= 1) {
+        // Pixels 0 and 1 are in the upper half of the word.
+        src(a10, src_reg, src_reg);
+        if (first_pos == 0) {
+            if (last_pos >= 1) {
+                s16i(a10, dst_reg, offset + FIX_OFFSET(0));
+            } else {
+                s8i(a10, dst_reg, offset + FIX_OFFSET(0));
+            }
+        } else {
+            srli(a10, a10, 8);
+            s8i(a10, dst_reg, offset + FIX_OFFSET(1));
+        }
+    }
+    if (last_pos >= 2) {
+        // Pixels 2 and 3 are in the lower half of the word.
+        if (first_pos <= 2) {
+            if (last_pos == 3) {
+                s16i(src_reg, dst_reg, offset + FIX_OFFSET(2));
+            } else {
+                s8i(src_reg, dst_reg, offset + FIX_OFFSET(2));
+            }
+        } else {
+            srli(a10, src_reg, 8);
+            s8i(a10, dst_reg, offset + FIX_OFFSET(3));
+        }
+    }
+}
+
 void EspFunction::do_fixups(EspFixups& fixups) {
     uint32_t save_pc = get_code_index();
     for (auto fixup = fixups.begin();
@@ -1325,6 +1782,13 @@ void EspFunction::bgez_to_here(reg_t src, s_off_t from) {
     set_code_index(save_pc);
 }
 
+void EspFunction::bnez_to_here(reg_t src, s_off_t from) {
+    auto save_pc = get_code_index();
+    set_code_index(from);
+    bnez(src, save_pc - from - 4);
+    set_code_index(save_pc);
+}
+
 
 void EspFunction::l32r_from(reg_t reg, uint32_t from) {
     l32r(reg, from - ((get_code_index() + 3) & 0xFFFFFFFC));
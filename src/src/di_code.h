@@ -76,6 +76,24 @@ class EspFunction {
     void copy_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
         uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels);
 
+    void copy_shifted_line_as_outer_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
+    void copy_shifted_line_as_inner_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
+    void copy_shifted_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
+    void copy_mirrored_line_as_outer_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
+    void copy_mirrored_line_as_inner_fcn(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
+    void copy_mirrored_line_loop(EspFixups& fixups, uint32_t draw_x, uint32_t x, uint32_t width,
+        uint16_t flags, uint8_t transparent_color, uint32_t* src_pixels, uint32_t src_x);
+
     // Common operations in functions:
 
     void do_fixups(EspFixups& fixups);
@@ -106,6 +124,9 @@ class EspFunction {
     uint16_t dup8_to_16(uint8_t value);
     uint32_t dup8_to_32(uint8_t value);
     uint32_t dup16_to_32(uint16_t value);
+    void add_to_reg(reg_t reg, int32_t value);
+    void store_shifted_pixels(uint32_t first_pos, uint32_t last_pos,
+            reg_t src_reg = a15, reg_t dst_reg = REG_DST_PIXEL_PTR, u_off_t offset = 0);
 
     // Assembler-level instructions:
 
@@ -121,6 +142,7 @@ class EspFunction {
     void bne(reg_t src, reg_t dst, s_off_t offset) { write24("bne", isdo(0x009007, src, dst, offset)); }
     void bnei(reg_t src, uint32_t imm, s_off_t offset) { write24("bnei", isieo(0x000066, src, imm, offset)); }
     void bnez(reg_t src, s_off_t offset) { write24("bnez", iso(0x000056, src, offset)); }
+    void bnez_to_here(reg_t src, s_off_t from);
     void bge(reg_t src, reg_t dst, s_off_t offset) { write24("bge", isdo(0x00A007, src, dst, offset)); }
     void bgei(reg_t src, uint32_t imm, s_off_t offset) { write24("bgei", isieo(0x0000E6, src, imm, offset)); }
     void bgeu(reg_t src, reg_t dst, s_off_t offset) { write24("bgeu", isdo(0x00B007, src, dst, offset)); }
@@ -155,7 +177,9 @@ class EspFunction {
     void s32i(reg_t dst, reg_t src, u_off_t offset) { write24("s32i", idso32(0x006002, dst, src, offset)); }
     void s8i(reg_t dst, reg_t src, u_off_t offset) { write24("s8i", idso8(0x004002, dst, src, offset)); }
     void slli(reg_t dst, reg_t src, uint8_t bits) { write24("slli", idsb(0x010000, dst, src, bits)); }
+    void src(reg_t dst, reg_t src_hi, reg_t src_lo) { write24("src", issd(0x810000, src_hi, src_lo, dst)); }
     void srli(reg_t dst, reg_t src, uint8_t bits) { write24("srli", idsrb(0x410000, dst, src, bits)); }
+    void ssai(uint8_t bits) { write24("ssai", 0x404000 | ((bits & 0xF) << 8) | (bits & 0x10)); }
     void sub(reg_t dst, reg_t src1, reg_t src2) { write24("sub", issd(0xC00000, src1, src2, dst)); }
 
     // a0 = return address
@@ -205,6 +229,7 @@ class EspFunction {
     uint32_t write32(const char* mnemonic, instr_t data);
     void call_inner_fcn(uint32_t real_address);
     void adjust_dst_pixel_ptr(uint32_t draw_x, uint32_t x);
+    void shift_word_for_copy(uint32_t delta, bool load_prev, bool load_next);
 
     inline instr_t issd(uint32_t instr, reg_t src1, reg_t src2, reg_t dst) {
         return instr | (dst << 12) | (src1 << 8) | (src2 << 4); }
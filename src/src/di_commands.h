@@ -38,19 +38,27 @@
 #define _column uint16_t m_column;
 #define _columns uint16_t m_columns;
 #define _coords int16_t  m_coords[1];
+#define _data   uint8_t  m_data[1];
 #define _distx  int16_t  m_distx;
 #define _disty  int16_t  m_disty;
 #define _distz  int16_t  m_distz;
+#define _dcolumn uint16_t m_dcolumn;
+#define _drow   uint16_t m_drow;
+#define _dx     int32_t  m_dx;
+#define _dy     int32_t  m_dy;
 #define _firstchar uint8_t m_firstchar;
 #define _fgcolor uint8_t m_fgcolor;
 #define _flags  uint16_t m_flags;
+#define _groups uint16_t m_groups;
 #define _h      uint16_t m_h;
 #define _i0     uint16_t m_i0;
 #define _id     uint16_t m_id;
 #define _ix     int16_t  m_ix;
 #define _iy     int16_t  m_iy;
 #define _lastchar uint8_t m_lastchar;
+#define _mask   uint16_t m_mask;
 #define _mid    uint16_t m_mid;
+#define _mode   uint8_t  m_mode;
 #define _n      uint16_t m_n;
 #define _oid    uint16_t m_oid;
 #define _pid    uint16_t m_pid;
@@ -64,9 +72,12 @@
 #define _sx1    int16_t  m_sx1;
 #define _sy0    int16_t  m_sy0;
 #define _sy1    int16_t  m_sy1;
+#define _ticks  uint16_t m_ticks;
 #define _u0     uint16_t m_u0;
 #define _v0     uint16_t m_v0;
 #define _w      uint16_t m_w;
+#define _wx     int32_t  m_wx;
+#define _wy     int32_t  m_wy;
 #define _x      int16_t  m_x;
 #define _x0     int16_t  m_x0;
 #define _x1     int16_t  m_x1;
@@ -96,6 +107,10 @@ OTFCMD(1,(_id _x _y),_Set_primitive_position)
 OTFCMD(2,(_id _ix _iy),_Adjust_primitive_position)
 OTFCMD(3,(_id),_Delete_primitive)
 OTFCMD(4,(_id),_Generate_code_for_primitive)
+OTFCMD(5,(_id _dx _dy _n),_Set_primitive_auto_motion)
+OTFCMD(6,(_id _x _y _dx _dy _n),_Set_primitive_position_and_auto_motion)
+OTFCMD(7,(_id _groups _mask),_Set_primitive_collision_groups)
+OTFCMD(8,(_n _data),_Set_raster_program)
 OTFCMD(10,(_id _pid _flags _x _y _color),_Create_primitive_Point)
 OTFCMD(20,(_id _pid _flags _x1 _y1 _x2 _y2 _color),_Create_primitive_Line)
 OTFCMD(30,(_id _pid _flags _color _x1 _y1 _x2 _y2 _x3 _y3),_Create_primitive_Triangle_Outline)
@@ -127,6 +142,9 @@ OTFCMD(87,(_id _bmid _x _y _color),_Set_transparent_bitmap_pixel_in_Tile_Array)
 OTFCMD(88,(_id _bmid _x _y _n _colors),_Set_solid_bitmap_pixels_in_Tile_Array)
 OTFCMD(89,(_id _bmid _x _y _n _colors),_Set_masked_bitmap_pixels_in_Tile_Array)
 OTFCMD(90,(_id _bmid _x _y _n _colors),_Set_transparent_bitmap_pixels_in_Tile_Array)
+OTFCMD(91,(_id _column _row _columns _rows _bmid),_Fill_tile_region_in_Tile_Array)
+OTFCMD(92,(_id _column _row _columns _rows _data),_Set_tile_block_in_Tile_Array)
+OTFCMD(93,(_id _column _row _columns _rows _dcolumn _drow _mode),_Copy_tile_region_in_Tile_Array)
 OTFCMD(100,(_id _pid _flags _columns _rows _w _h),_Create_primitive_Tile_Map)
 OTFCMD(101,(_id _bmid),_Create_Solid_Bitmap_for_Tile_Map)
 OTFCMD(102,(_id _bmid _color),_Create_Masked_Bitmap_for_Tile_Map)
@@ -138,6 +156,15 @@ OTFCMD(107,(_id _bmid _x _y _color),_Set_transparent_bitmap_pixel_in_Tile_Map)
 OTFCMD(108,(_id _bmid _x _y _n _colors),_Set_solid_bitmap_pixels_in_Tile_Map)
 OTFCMD(109,(_id _bmid _x _y _n _colors),_Set_masked_bitmap_pixels_in_Tile_Map)
 OTFCMD(110,(_id _bmid _x _y _n _colors),_Set_transparent_bitmap_pixels_in_Tile_Map)
+OTFCMD(111,(_id _x _y),_Set_Tile_Map_scroll_position)
+OTFCMD(112,(_id _s _n _data),_Set_Tile_Map_line_table)
+OTFCMD(113,(_id _bmid _ticks _n _data),_Set_tile_animation_in_Tile_Map)
+OTFCMD(114,(_id _column _row _mode),_Set_tile_flip_in_Tile_Map)
+OTFCMD(115,(_id _column _row _columns _rows _bmid),_Fill_tile_region_in_Tile_Map)
+OTFCMD(116,(_id _column _row _columns _rows _data),_Set_tile_block_in_Tile_Map)
+OTFCMD(117,(_id _column _row _columns _rows _dcolumn _drow _mode),_Copy_tile_region_in_Tile_Map)
+OTFCMD(118,(_id _columns _rows),_Set_Tile_Map_world_size)
+OTFCMD(119,(_id _column _row _columns _rows _data),_Set_world_tile_block_in_Tile_Map)
 OTFCMD(120,(_id _pid _flags _w _h),_Create_primitive_Solid_Bitmap)
 OTFCMD(121,(_id _pid _flags _w _h _color),_Create_primitive_Masked_Bitmap)
 OTFCMD(122,(_id _pid _flags _w _h _color),_Create_primitive_Transparent_Bitmap)
@@ -156,7 +183,15 @@ OTFCMD(134,(_id _x _y _n _colors),_Set_transparent_bitmap_pixels)
 OTFCMD(135,(_id _pid _flags _bmid),_Create_primitive_Reference_Solid_Bitmap)
 OTFCMD(136,(_id _pid _flags _bmid),_Create_primitive_Reference_Masked_Bitmap)
 OTFCMD(137,(_id _pid _flags _bmid),_Create_primitive_Reference_Transparent_Bitmap)
+OTFCMD(138,(_id _h _n _ticks _mode),_Set_bitmap_animation)
+OTFCMD(139,(_mode),_Select_bitmap_memory)
 OTFCMD(140,(_id _pid _flags _x _y _w _h),_Create_primitive_Group)
+OTFCMD(141,(_id _x _y _n _data),_Set_bitmap_pixels_compressed)
+OTFCMD(142,(_id _pid _flags _w _h _mode),_Create_primitive_Palette_Bitmap)
+OTFCMD(143,(_id _i0 _n _colors),_Set_palette_bitmap_colors)
+OTFCMD(144,(_id _x _y _n _data),_Set_palette_bitmap_pixels)
+OTFCMD(145,(_id _mode),_Set_bitmap_flip)
+OTFCMD(146,(_id _wx _wy),_Set_Tile_Map_world_scroll_position)
 OTFCMD(150,(_id _pid _flags _x _y _columns _rows),_Create_primitive_Terminal)
 OTFCMD(151,(_id),_Select_Active_Terminal)
 OTFCMD(152,(_id _char _fgcolor _bgcolor),_Define_Terminal_Character)
@@ -187,6 +222,10 @@ typedef union {
     OtfCmd_2_Adjust_primitive_position m_2_Adjust_primitive_position;
     OtfCmd_3_Delete_primitive m_3_Delete_primitive;
     OtfCmd_4_Generate_code_for_primitive m_4_Generate_code_for_primitive;
+    OtfCmd_5_Set_primitive_auto_motion m_5_Set_primitive_auto_motion;
+    OtfCmd_6_Set_primitive_position_and_auto_motion m_6_Set_primitive_position_and_auto_motion;
+    OtfCmd_7_Set_primitive_collision_groups m_7_Set_primitive_collision_groups;
+    OtfCmd_8_Set_raster_program m_8_Set_raster_program;
     OtfCmd_10_Create_primitive_Point m_10_Create_primitive_Point;
     OtfCmd_20_Create_primitive_Line m_20_Create_primitive_Line;
     OtfCmd_30_Create_primitive_Triangle_Outline m_30_Create_primitive_Triangle_Outline;
@@ -218,6 +257,9 @@ typedef union {
     OtfCmd_88_Set_solid_bitmap_pixels_in_Tile_Array m_88_Set_solid_bitmap_pixels_in_Tile_Array;
     OtfCmd_89_Set_masked_bitmap_pixels_in_Tile_Array m_89_Set_masked_bitmap_pixels_in_Tile_Array;
     OtfCmd_90_Set_transparent_bitmap_pixels_in_Tile_Array m_90_Set_transparent_bitmap_pixels_in_Tile_Array;
+    OtfCmd_91_Fill_tile_region_in_Tile_Array m_91_Fill_tile_region_in_Tile_Array;
+    OtfCmd_92_Set_tile_block_in_Tile_Array m_92_Set_tile_block_in_Tile_Array;
+    OtfCmd_93_Copy_tile_region_in_Tile_Array m_93_Copy_tile_region_in_Tile_Array;
     OtfCmd_100_Create_primitive_Tile_Map m_100_Create_primitive_Tile_Map;
     OtfCmd_101_Create_Solid_Bitmap_for_Tile_Map m_101_Create_Solid_Bitmap_for_Tile_Map;
     OtfCmd_102_Create_Masked_Bitmap_for_Tile_Map m_102_Create_Masked_Bitmap_for_Tile_Map;
@@ -229,6 +271,15 @@ typedef union {
     OtfCmd_108_Set_solid_bitmap_pixels_in_Tile_Map m_108_Set_solid_bitmap_pixels_in_Tile_Map;
     OtfCmd_109_Set_masked_bitmap_pixels_in_Tile_Map m_109_Set_masked_bitmap_pixels_in_Tile_Map;
     OtfCmd_110_Set_transparent_bitmap_pixels_in_Tile_Map m_110_Set_transparent_bitmap_pixels_in_Tile_Map;
+    OtfCmd_111_Set_Tile_Map_scroll_position m_111_Set_Tile_Map_scroll_position;
+    OtfCmd_112_Set_Tile_Map_line_table m_112_Set_Tile_Map_line_table;
+    OtfCmd_113_Set_tile_animation_in_Tile_Map m_113_Set_tile_animation_in_Tile_Map;
+    OtfCmd_114_Set_tile_flip_in_Tile_Map m_114_Set_tile_flip_in_Tile_Map;
+    OtfCmd_115_Fill_tile_region_in_Tile_Map m_115_Fill_tile_region_in_Tile_Map;
+    OtfCmd_116_Set_tile_block_in_Tile_Map m_116_Set_tile_block_in_Tile_Map;
+    OtfCmd_117_Copy_tile_region_in_Tile_Map m_117_Copy_tile_region_in_Tile_Map;
+    OtfCmd_118_Set_Tile_Map_world_size m_118_Set_Tile_Map_world_size;
+    OtfCmd_119_Set_world_tile_block_in_Tile_Map m_119_Set_world_tile_block_in_Tile_Map;
     OtfCmd_120_Create_primitive_Solid_Bitmap m_120_Create_primitive_Solid_Bitmap;
     OtfCmd_121_Create_primitive_Masked_Bitmap m_121_Create_primitive_Masked_Bitmap;
     OtfCmd_122_Create_primitive_Transparent_Bitmap m_122_Create_primitive_Transparent_Bitmap;
@@ -247,7 +298,15 @@ typedef union {
     OtfCmd_135_Create_primitive_Reference_Solid_Bitmap m_135_Create_primitive_Reference_Solid_Bitmap;
     OtfCmd_136_Create_primitive_Reference_Masked_Bitmap m_136_Create_primitive_Reference_Masked_Bitmap;
     OtfCmd_137_Create_primitive_Reference_Transparent_Bitmap m_137_Create_primitive_Reference_Transparent_Bitmap;
+    OtfCmd_138_Set_bitmap_animation m_138_Set_bitmap_animation;
+    OtfCmd_139_Select_bitmap_memory m_139_Select_bitmap_memory;
     OtfCmd_140_Create_primitive_Group m_140_Create_primitive_Group;
+    OtfCmd_141_Set_bitmap_pixels_compressed m_141_Set_bitmap_pixels_compressed;
+    OtfCmd_142_Create_primitive_Palette_Bitmap m_142_Create_primitive_Palette_Bitmap;
+    OtfCmd_143_Set_palette_bitmap_colors m_143_Set_palette_bitmap_colors;
+    OtfCmd_144_Set_palette_bitmap_pixels m_144_Set_palette_bitmap_pixels;
+    OtfCmd_145_Set_bitmap_flip m_145_Set_bitmap_flip;
+    OtfCmd_146_Set_Tile_Map_world_scroll_position m_146_Set_Tile_Map_world_scroll_position;
     OtfCmd_150_Create_primitive_Terminal m_150_Create_primitive_Terminal;
     OtfCmd_151_Select_Active_Terminal m_151_Select_Active_Terminal;
     OtfCmd_152_Define_Terminal_Character m_152_Define_Terminal_Character;
@@ -322,6 +322,35 @@ void DiGeneralLine::make_solid_quad_strip(uint16_t flags,
   create_functions();
 }
 
+bool DiGeneralLine::find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  if (!DiPrimitive::find_drawn_run(line_index, x, x_extent)) {
+    return false;
+  }
+  auto row = line_index - m_abs_y - m_line_details.m_min_y;
+  if (row < 0 || row >= (int32_t)m_line_details.m_sections.size()) {
+    return false;
+  }
+
+  // Pieces are not kept in X order, so choose the one that starts first within the span.
+  auto sections = &m_line_details.m_sections[row];
+  int32_t run_x = x_extent;
+  int32_t run_x_extent = x_extent;
+  for (auto piece = sections->m_pieces.begin(); piece != sections->m_pieces.end(); ++piece) {
+    int32_t px = MAX(x, m_abs_x + piece->m_x);
+    int32_t pe = MIN(x_extent, m_abs_x + piece->m_x + piece->m_width);
+    if (px < pe && px < run_x) {
+      run_x = px;
+      run_x_extent = pe;
+    }
+  }
+  if (run_x >= x_extent) {
+    return false;
+  }
+  x = run_x;
+  x_extent = run_x_extent;
+  return true;
+}
+
 void IRAM_ATTR DiGeneralLine::delete_instructions() {
   if (m_flags & PRIM_FLAG_H_SCROLL_1) {
     for (uint32_t pos = 0; pos < 4; pos++) {
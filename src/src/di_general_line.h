@@ -129,6 +129,9 @@ class DiGeneralLine: public DiPrimitive {
   void make_solid_quad_strip(uint16_t flags, int16_t* coords,
             uint16_t n, uint8_t color, uint8_t opaqueness);
 
+  // Find the first run of drawn pixels on the given line, within the given span.
+  virtual bool find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent);
+
   // Clear the custom instructions needed to draw the primitive.
   virtual void IRAM_ATTR delete_instructions();
    
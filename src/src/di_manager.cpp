@@ -84,6 +84,8 @@ DiManager::DiManager() {
   m_terminal = NULL;
   m_cursor = NULL;
   m_flash_count = 0;
+  m_bitmap_memory = BITMAP_MEMORY_INTERNAL;
+  m_raster_index = 0;
   m_on_vertical_blank_cb = &default_on_vertical_blank;
   memset(m_primitives, 0, sizeof(m_primitives));
 
@@ -228,6 +230,7 @@ void DiManager::clear() {
     for (int g = 0; g < ACT_LINES; g++) {
         std::vector<DiPrimitive*> * vp = &m_groups[g];
         vp->clear();
+        m_paint_lists[g].clear();
     }
 
     for (int i = FIRST_PRIMITIVE_ID; i <= LAST_PRIMITIVE_ID; i++) {
@@ -237,6 +240,14 @@ void DiManager::clear() {
       }
     }
     m_primitives[ROOT_PRIMITIVE_ID]->clear_child_ptrs();
+    m_animated_bitmaps.clear();
+    m_animated_tile_maps.clear();
+    m_world_tile_maps.clear();
+    m_psram_bitmaps.clear();
+    m_colliders.clear();
+    m_collisions.clear();
+    m_raster_program.clear();
+    m_pending_renders.clear();
 
     heap_caps_free((void*)m_dma_descriptor);
     heap_caps_free((void*)m_video_buffer);
@@ -257,7 +268,8 @@ void DiManager::add_primitive(DiPrimitive* prim, DiPrimitive* parent) {
     }
 
     m_primitives[prim->get_id()] = prim;
-    recompute_primitive(prim, 0, -1, -1);
+    prim->set_raster_target(is_raster_target_id(prim->get_id()));
+    recompute_primitive(prim);
 
     /*debug_log("\n-- Groups\n");
     for (int i = 0; i < 600; i++) {
@@ -272,17 +284,49 @@ void DiManager::add_primitive(DiPrimitive* prim, DiPrimitive* parent) {
 
 void DiManager::remove_primitive(DiPrimitive* prim) {
   if (prim) {
-    if (prim->get_flags() & PRIM_FLAGS_CAN_DRAW) {
-      int32_t min_group, max_group;
-      if (prim->get_vertical_group_range(min_group, max_group)) {
-        for (int32_t g = min_group; g <= max_group; g++) {
-          std::vector<DiPrimitive*> * vp = &m_groups[g];
-          auto position2 = std::find(vp->begin(), vp->end(), prim);
-          if (position2 != vp->end()) {
-            vp->erase(position2);
-          }
+    int32_t min_group = prim->get_first_group();
+    int32_t max_group = prim->get_last_group();
+    if (min_group >= 0) {
+      for (int32_t g = min_group; g <= max_group; g++) {
+        std::vector<DiPrimitive*> * vp = &m_groups[g];
+        auto position2 = std::find(vp->begin(), vp->end(), prim);
+        if (position2 != vp->end()) {
+          vp->erase(position2);
         }
       }
+      cull_groups(min_group, max_group);
+    }
+
+    auto anim = std::find(m_animated_bitmaps.begin(), m_animated_bitmaps.end(), prim);
+    if (anim != m_animated_bitmaps.end()) {
+      m_animated_bitmaps.erase(anim);
+    }
+
+    auto anim_map = std::find(m_animated_tile_maps.begin(), m_animated_tile_maps.end(), prim);
+    if (anim_map != m_animated_tile_maps.end()) {
+      m_animated_tile_maps.erase(anim_map);
+    }
+
+    auto world_map = std::find(m_world_tile_maps.begin(), m_world_tile_maps.end(), prim);
+    if (world_map != m_world_tile_maps.end()) {
+      m_world_tile_maps.erase(world_map);
+    }
+
+    auto cached = std::find(m_psram_bitmaps.begin(), m_psram_bitmaps.end(), prim);
+    if (cached != m_psram_bitmaps.end()) {
+      m_psram_bitmaps.erase(cached);
+    }
+
+    auto pending = std::find(m_pending_renders.begin(), m_pending_renders.end(), prim);
+    if (pending != m_pending_renders.end()) {
+      m_pending_renders.erase(pending);
+    }
+
+    for (auto collider = m_colliders.begin(); collider != m_colliders.end(); ++collider) {
+      if (collider->m_id == prim->get_id()) {
+        m_colliders.erase(collider);
+        break;
+      }
     }
 
     prim->get_parent()->detach_child(prim);
@@ -298,104 +342,168 @@ void DiManager::remove_primitive(DiPrimitive* prim) {
   }
 }
 
-void DiManager::recompute_primitive(DiPrimitive* prim, uint16_t old_flags,
-                                    int32_t old_min_group, int32_t old_max_group) {
-  //if (prim->get_id()>2) debug_log("RECOMPUTE id %hu f %04hX g %i %i ... ", prim->get_id(), old_flags, old_min_group, old_max_group);
+void DiManager::gather_subtree(DiPrimitive* prim) {
+  DiSubtreeMember member;
+  member.m_prim = prim;
+  member.m_old_draw_x = prim->get_draw_x();
+  member.m_old_draw_x_offset = prim->get_draw_x() - prim->get_absolute_x();
+  member.m_old_draw_width = prim->get_draw_x_extent() - prim->get_draw_x();
+  member.m_old_first_group = prim->get_first_group();
+  member.m_old_last_group = prim->get_last_group();
+  m_subtree.push_back(member);
+
+  DiPrimitive* child = prim->get_first_child();
+  while (child) {
+    gather_subtree(child);
+    child = child->get_next_sibling();
+  }
+}
+
+void DiManager::recompute_primitive(DiPrimitive* prim) {
+  // Moving, resizing, or hiding a primitive also affects all of its descendants,
+  // so the whole subtree is handled together.
+  m_subtree.clear();
+  gather_subtree(prim);
+
   auto parent = prim->get_parent();
   prim->compute_absolute_geometry(parent->get_view_x(), parent->get_view_y(),
     parent->get_view_x_extent(), parent->get_view_y_extent());
 
-  bool old_use_groups = (old_min_group >= 0);
-  bool new_use_groups = false;
-  int32_t new_min_group = -1;
-  int32_t new_max_group = -1;
-  if (prim->get_flags() & PRIM_FLAG_PAINT_THIS) {
-    new_use_groups = prim->get_vertical_group_range(new_min_group, new_max_group);
-  }
-  
-  if (old_use_groups) {
-    if (new_use_groups) {
-      // Adjust which groups primitive is in
-      //
-      // There are several (vertical) cases:
-      // 1. New groups fully above old groups.
-      // 2. New groups cross first old group, but not last old group.
-      // 3. New groups fully within old groups.
-      // 4. New groups cross last old group, but not first old group.
-      // 5. New groups fully below old groups.
-      // 6. Old groups fully within new groups.
-
-      if (old_min_group < new_min_group) {
-        // Remove primitive from old groups that are above new groups
-        int32_t end = MIN((old_max_group+1), new_min_group);
-        for (int32_t g = old_min_group; g < end; g++) {
-          std::vector<DiPrimitive*> * vp = &m_groups[g];
-          auto position2 = std::find(vp->begin(), vp->end(), prim);
-          if (position2 != vp->end()) {
-            vp->erase(position2);
-          }
-        }
+  // Determine the new range of groups for each member, and the overall
+  // range of groups that may need to change.
+  int32_t min_group = ACT_LINES;
+  int32_t max_group = -1;
+  for (auto member = m_subtree.begin(); member != m_subtree.end(); ++member) {
+    auto p = member->m_prim;
+    member->m_new_first_group = -1;
+    member->m_new_last_group = -1;
+    if (p->get_flags() & PRIM_FLAG_PAINT_THIS) {
+      int32_t first, last;
+      if (p->get_vertical_group_range(first, last)) {
+        member->m_new_first_group = first;
+        member->m_new_last_group = last;
+        min_group = MIN(min_group, first);
+        max_group = MAX(max_group, last);
       }
+    }
+    if (member->m_old_first_group >= 0) {
+      min_group = MIN(min_group, member->m_old_first_group);
+      max_group = MAX(max_group, member->m_old_last_group);
+    }
+  }
 
-      if (old_max_group > new_max_group) {
-        // Remove primitive from old groups that are below new groups
-        int32_t begin = MAX((new_max_group+1), old_min_group);
-        for (int32_t g = begin; g <= old_max_group; g++) {
-          std::vector<DiPrimitive*> * vp = &m_groups[g];
-          auto position2 = std::find(vp->begin(), vp->end(), prim);
+  // Adjust group membership in a single pass over the affected groups, and
+  // rebuild the paint list of any group that holds (or held) a member, because
+  // moving a primitive may change what it covers, or what covers it.
+  for (int32_t g = min_group; g <= max_group; g++) {
+    std::vector<DiPrimitive*> * vp = &m_groups[g];
+    bool touched = false;
+    for (auto member = m_subtree.begin(); member != m_subtree.end(); ++member) {
+      bool was_in = (g >= member->m_old_first_group && g <= member->m_old_last_group);
+      bool is_in = (g >= member->m_new_first_group && g <= member->m_new_last_group);
+      if (was_in) {
+        touched = true;
+        if (!is_in) {
+          auto position2 = std::find(vp->begin(), vp->end(), member->m_prim);
           if (position2 != vp->end()) {
             vp->erase(position2);
           }
         }
+      } else if (is_in) {
+        touched = true;
+        vp->push_back(member->m_prim);
       }
+    }
+    if (touched) {
+      cull_groups(g, g);
+    }
+  }
 
-      if (new_min_group < old_min_group) {
-        // Add primitive to new groups that are above old groups
-        int32_t end = MIN((new_max_group+1), old_min_group);
-        for (int32_t g = new_min_group; g < end; g++) {
-          std::vector<DiPrimitive*> * vp = &m_groups[g];
-          vp->push_back(prim);
+  for (auto member = m_subtree.begin(); member != m_subtree.end(); ++member) {
+    auto p = member->m_prim;
+    p->set_groups(member->m_new_first_group, member->m_new_last_group);
+    if (member->m_new_first_group >= 0) {
+      p->add_flags(PRIM_FLAGS_CAN_DRAW);
+
+      // The generated code of a primitive that was already drawable depends on
+      // the sub-word phase of its drawing position (unless it has code for all
+      // 4 phases), and on its horizontal clipping. Regenerate it only if one
+      // of those changed.
+      if (member->m_old_first_group >= 0) {
+        auto draw_x = p->get_draw_x();
+        bool regenerate =
+          (member->m_old_draw_x_offset != draw_x - p->get_absolute_x()) ||
+          (member->m_old_draw_width != p->get_draw_x_extent() - draw_x) ||
+          (((member->m_old_draw_x ^ draw_x) & 3) && !(p->get_flags() & PRIM_FLAG_H_SCROLL_1));
+        if (regenerate) {
+          p->delete_instructions();
+          p->generate_instructions();
         }
       }
+    } else {
+      p->remove_flags(PRIM_FLAGS_CAN_DRAW);
+    }
+  }
+}
 
-      if (new_max_group > old_max_group) {
-        // Add primitive to new groups that are below old groups
-        int32_t begin = MAX((old_max_group+1), new_min_group);
-        for (int32_t g = begin; g <= new_max_group; g++) {
-          std::vector<DiPrimitive*> * vp = &m_groups[g];
-          vp->push_back(prim);
+void DiManager::cull_groups(int32_t min_group, int32_t max_group) {
+  // A few disjoint opaque spans are enough for typical layering. If more are
+  // found on a line, the extra ones are ignored, which only culls less.
+  const int32_t max_spans = 8;
+  int32_t span_x[max_spans];
+  int32_t span_x_extent[max_spans];
+
+  min_group = MAX(min_group, 0);
+  max_group = MIN(max_group, ACT_LINES - 1);
+  for (int32_t g = min_group; g <= max_group; g++) {
+    std::vector<DiPrimitive*> * vp = &m_groups[g];
+    std::vector<DiPrimitive*> * pl = &m_paint_lists[g];
+    pl->clear();
+    int32_t num_spans = 0;
+
+    // Visit the primitives from the top-most (painted last) downward.
+    for (auto p = vp->rbegin(); p != vp->rend(); ++p) {
+      auto prim = *p;
+      int32_t x, x_extent;
+      prim->get_paint_span(x, x_extent);
+      bool hidden = false;
+      for (int32_t s = 0; s < num_spans; s++) {
+        if (x >= span_x[s] && x_extent <= span_x_extent[s]) {
+          hidden = true;
+          break;
         }
       }
-
-      prim->add_flags(PRIM_FLAGS_CAN_DRAW);
-      //prim->generate_instructions();
-    } else {
-      // Just remove primitive from old groups
-      for (int32_t g = old_min_group; g <= old_max_group; g++) {
-        std::vector<DiPrimitive*> * vp = &m_groups[g];
-        auto position2 = std::find(vp->begin(), vp->end(), prim);
-        if (position2 != vp->end()) {
-          vp->erase(position2);
-        }
+      if (hidden) {
+        continue;
       }
-      prim->remove_flags(PRIM_FLAGS_CAN_DRAW);
-      //prim->delete_instructions();
-    }
-  } else {
-    if (new_use_groups) {
-      // Just place primitive into new groups
-      for (int32_t g = new_min_group; g <= new_max_group; g++) {
-        std::vector<DiPrimitive*> * vp = &m_groups[g];
-        vp->push_back(prim);
+      pl->push_back(prim);
+
+      // A primitive that the raster program may hide, recolor, or change the slice
+      // of does not always cover the same pixels, so it hides nothing beneath it.
+      if (!prim->is_raster_target() && prim->get_opaque_span(g, x, x_extent) && x < x_extent) {
+        // Merge the new span with any spans that it overlaps or touches.
+        int32_t s = 0;
+        while (s < num_spans) {
+          if (x <= span_x_extent[s] && x_extent >= span_x[s]) {
+            x = MIN(x, span_x[s]);
+            x_extent = MAX(x_extent, span_x_extent[s]);
+            num_spans--;
+            span_x[s] = span_x[num_spans];
+            span_x_extent[s] = span_x_extent[num_spans];
+          } else {
+            s++;
+          }
+        }
+        if (num_spans < max_spans) {
+          span_x[num_spans] = x;
+          span_x_extent[num_spans++] = x_extent;
+        }
       }
-      prim->add_flags(PRIM_FLAGS_CAN_DRAW);
-      //prim->generate_instructions();
-    } else {
-      prim->remove_flags(PRIM_FLAGS_CAN_DRAW);
-      //prim->delete_instructions();
     }
+
+    // Restore the painting order (bottom-most first).
+    std::reverse(pl->begin(), pl->end());
   }
-  //if (prim->get_id()>2) debug_log(" computed id %hu f %04hX g %i %i\n", prim->get_id(), prim->get_flags(), new_min_group, new_max_group);
 }
 
 DiPrimitive* DiManager::finish_create(uint16_t id, uint16_t flags, DiPrimitive* prim, DiPrimitive* parent_prim) {
@@ -695,7 +803,7 @@ DiTileArray* DiManager::create_tile_array(uint16_t id, uint16_t parent, uint16_t
 
     flags |= PRIM_FLAGS_X_SRC;
     DiTileArray* tile_array =
-      new DiTileArray(screen_width, screen_height, columns, rows, width, height, flags);
+      new DiTileArray(screen_width, screen_height, columns, rows, width, height, flags, true);
 
     finish_create(id, flags, tile_array, parent_prim);
     return tile_array;
@@ -763,6 +871,9 @@ void IRAM_ATTR DiManager::loop() {
         }
       }
 
+      // Use the spare time to copy upcoming lines of PSRAM bitmaps into internal RAM.
+      prefetch_bitmap_lines(current_line_index + BITMAP_CACHE_LINES);
+
       loop_state = LoopState::WritingActiveLines;
 
       while (ESPSerial.available() > 0) {
@@ -775,6 +886,11 @@ void IRAM_ATTR DiManager::loop() {
         process_character(ESPSerial.read());
       }
       (*m_on_vertical_blank_cb)();
+      run_auto_motion();
+      run_bitmap_animation();
+      refill_tile_map_windows();
+      run_pending_render();
+      run_collision_detection();
 
       if (terminalMode && cursorEnabled && m_cursor) {
         auto flags = m_cursor->get_flags();
@@ -808,6 +924,7 @@ void IRAM_ATTR DiManager::loop() {
     } else if (loop_state == LoopState::ProcessingIncomingData) {
       if (descr_index >= DMA_TOTAL_DESCR - DMA_ACT_LINES - 1) {
         // Prepare the start of the next frame.
+        start_bitmap_caches();
         for (current_line_index = 0, current_buffer_index = 0;
               current_buffer_index < NUM_ACTIVE_BUFFERS;
               current_line_index++, current_buffer_index++) {
@@ -835,10 +952,197 @@ void IRAM_ATTR DiManager::loop() {
   }
 }
 
+void DiManager::run_auto_motion() {
+  // Apply all of the moves first, and then adjust the paint groups of the
+  // primitives that actually moved. Each primitive remembers the groups that
+  // it is in, so the order of the adjustments does not matter.
+  m_auto_moved.clear();
+  for (int i = FIRST_PRIMITIVE_ID; i <= LAST_PRIMITIVE_ID; i++) {
+    auto prim = m_primitives[i];
+    if (prim && prim->get_auto_moves()) {
+      if (prim->apply_auto_move()) {
+        m_auto_moved.push_back(prim);
+      }
+    }
+  }
+
+  for (auto prim = m_auto_moved.begin(); prim != m_auto_moved.end(); ++prim) {
+    recompute_primitive(*prim);
+  }
+}
+
+void DiManager::run_bitmap_animation() {
+  for (auto bitmap = m_animated_bitmaps.begin(); bitmap != m_animated_bitmaps.end(); ++bitmap) {
+    (*bitmap)->animate();
+  }
+  for (auto tile_map = m_animated_tile_maps.begin(); tile_map != m_animated_tile_maps.end(); ++tile_map) {
+    (*tile_map)->animate();
+  }
+}
+
+void DiManager::refill_tile_map_windows() {
+  for (auto tile_map = m_world_tile_maps.begin(); tile_map != m_world_tile_maps.end(); ++tile_map) {
+    (*tile_map)->refill_window();
+  }
+}
+
+void DiManager::run_pending_render() {
+  // A scene can take most of the blanking period, so only one is drawn per frame.
+  if (!m_pending_renders.empty()) {
+    auto prim = m_pending_renders.front();
+    m_pending_renders.erase(m_pending_renders.begin());
+    prim->render();
+    prim->delete_instructions();
+    prim->generate_instructions();
+  }
+}
+
+void IRAM_ATTR DiManager::start_bitmap_caches() {
+  for (auto bitmap = m_psram_bitmaps.begin(); bitmap != m_psram_bitmaps.end(); ++bitmap) {
+    (*bitmap)->start_line_cache();
+  }
+}
+
+void IRAM_ATTR DiManager::prefetch_bitmap_lines(int32_t end_line_index) {
+  for (auto bitmap = m_psram_bitmaps.begin(); bitmap != m_psram_bitmaps.end(); ++bitmap) {
+    (*bitmap)->prefetch_lines(end_line_index);
+  }
+}
+
+void DiManager::run_collision_detection() {
+  m_new_collisions.clear();
+  auto num_colliders = m_colliders.size();
+  for (uint32_t i = 0; i < num_colliders; i++) {
+    auto c1 = &m_colliders[i];
+    for (uint32_t j = i + 1; j < num_colliders; j++) {
+      auto c2 = &m_colliders[j];
+      if ((c1->m_mask & c2->m_groups) || (c2->m_mask & c1->m_groups)) {
+        if (check_collision(m_primitives[c1->m_id], m_primitives[c2->m_id])) {
+          uint32_t id1 = MIN(c1->m_id, c2->m_id);
+          uint32_t id2 = MAX(c1->m_id, c2->m_id);
+          m_new_collisions.push_back((id1 << 16) | id2);
+        }
+      }
+    }
+  }
+  std::sort(m_new_collisions.begin(), m_new_collisions.end());
+
+  // Both lists are sorted, so one pass finds the pairs that are in only one of them.
+  // A pair that stays in collision is not reported again.
+  uint16_t ids[MAX_COLLISION_PAIRS * 2];
+  uint32_t num_pairs = 0;
+  auto old_pair = m_collisions.begin();
+  auto new_pair = m_new_collisions.begin();
+  while (old_pair != m_collisions.end() || new_pair != m_new_collisions.end()) {
+    uint32_t pair;
+    uint16_t ended = 0;
+    if (old_pair == m_collisions.end() ||
+        (new_pair != m_new_collisions.end() && *new_pair < *old_pair)) {
+      pair = *new_pair++;
+    } else if (new_pair == m_new_collisions.end() || *old_pair < *new_pair) {
+      pair = *old_pair++;
+      ended = COLLISION_ENDED;
+    } else {
+      ++old_pair;
+      ++new_pair;
+      continue;
+    }
+
+    ids[num_pairs * 2] = (uint16_t)(pair >> 16);
+    ids[num_pairs * 2 + 1] = (uint16_t)pair | ended;
+    if (++num_pairs >= MAX_COLLISION_PAIRS) {
+      send_collisions(ids, num_pairs);
+      num_pairs = 0;
+    }
+  }
+
+  if (num_pairs) {
+    send_collisions(ids, num_pairs);
+  }
+  m_collisions.swap(m_new_collisions);
+}
+
+bool DiManager::check_collision(DiPrimitive* prim1, DiPrimitive* prim2) {
+  // Only primitives that are presently drawn can collide.
+  auto flags1 = prim1->get_flags();
+  auto flags2 = prim2->get_flags();
+  if (!(flags1 & flags2 & PRIM_FLAGS_CAN_DRAW) || !(flags1 & flags2 & PRIM_FLAG_PAINT_THIS)) {
+    return false;
+  }
+
+  // Check whether the bounding boxes intersect.
+  int32_t x = MAX(prim1->get_draw_x(), prim2->get_draw_x());
+  int32_t y = MAX(prim1->get_draw_y(), prim2->get_draw_y());
+  int32_t x_extent = MIN(prim1->get_draw_x_extent(), prim2->get_draw_x_extent());
+  int32_t y_extent = MIN(prim1->get_draw_y_extent(), prim2->get_draw_y_extent());
+  if (x >= x_extent || y >= y_extent) {
+    return false;
+  }
+
+  // Check whether any drawn pixels overlap, line by line, within the intersection.
+  for (int32_t line = y; line < y_extent; line++) {
+    int32_t next_x = x;
+    while (next_x < x_extent) {
+      int32_t x1 = next_x;
+      int32_t x1_extent = x_extent;
+      if (!prim1->find_drawn_run(line, x1, x1_extent)) {
+        break;
+      }
+      int32_t x2 = x1;
+      int32_t x2_extent = x1_extent;
+      if (prim2->find_drawn_run(line, x2, x2_extent)) {
+        return true;
+      }
+      next_x = x1_extent;
+    }
+  }
+  return false;
+}
+
+void IRAM_ATTR DiManager::run_raster_program(uint32_t line_index) {
+  if (line_index == 0) {
+    m_raster_index = 0;
+  }
+  auto num_actions = m_raster_program.size();
+  while (m_raster_index < num_actions) {
+    auto action = &m_raster_program[m_raster_index];
+    if (action->m_line > line_index) {
+      break;
+    }
+    m_raster_index++;
+    if (action->m_id > LAST_PRIMITIVE_ID) {
+      continue;
+    }
+    auto prim = m_primitives[action->m_id];
+    if (!prim) {
+      continue;
+    }
+    switch (action->m_action) {
+      case RASTER_SET_COLOR:
+        prim->set_color32(PIXEL_COLOR_X4((uint8_t)action->m_value));
+        break;
+      case RASTER_HIDE:
+        prim->set_raster_hidden(true);
+        break;
+      case RASTER_SHOW:
+        prim->set_raster_hidden(false);
+        break;
+      case RASTER_SET_SLICE:
+        prim->set_visible_line(action->m_value);
+        break;
+    }
+  }
+}
+
 void IRAM_ATTR DiManager::draw_primitives(volatile uint32_t* p_scan_line, uint32_t line_index) {
-  std::vector<DiPrimitive*> * vp = &m_groups[line_index];
+  if (m_raster_program.size()) {
+    run_raster_program(line_index);
+  }
+  std::vector<DiPrimitive*> * vp = &m_paint_lists[line_index];
   for (auto prim = vp->begin(); prim != vp->end(); ++prim) {
+    if (!(*prim)->is_raster_hidden()) {
       (*prim)->paint(p_scan_line, line_index);
+    }
   }
 }
 
@@ -1283,6 +1587,47 @@ bool DiManager::handle_otf_cmd() {
         }
       } break;
 
+      case 5: {
+        auto cmd = &cu->m_5_Set_primitive_auto_motion;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_primitive_auto_motion(cmd->m_id, cmd->m_dx, cmd->m_dy, cmd->m_n);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 6: {
+        auto cmd = &cu->m_6_Set_primitive_position_and_auto_motion;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_primitive_position_and_auto_motion(cmd->m_id, cmd->m_x, cmd->m_y,
+            cmd->m_dx, cmd->m_dy, cmd->m_n);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 7: {
+        auto cmd = &cu->m_7_Set_primitive_collision_groups;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_primitive_collision_groups(cmd->m_id, cmd->m_groups, cmd->m_mask);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 8: {
+        auto cmd = &cu->m_8_Set_raster_program;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint32_t)cmd->m_n * RASTER_ACTION_SIZE;
+          if (len >= total_size) {
+            set_raster_program(cmd->m_n, cmd->m_data);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
       case 10: {
         auto cmd = &cu->m_10_Create_primitive_Point;
         if (m_incoming_command.size() == sizeof(*cmd)) {
@@ -1650,6 +1995,40 @@ bool DiManager::handle_otf_cmd() {
         }
       } break;
 
+      case 91: {
+        auto cmd = &cu->m_91_Fill_tile_region_in_Tile_Array;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          fill_tile_array_region(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows, cmd->m_bmid);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 92: {
+        auto cmd = &cu->m_92_Set_tile_block_in_Tile_Array;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          // The block size can exceed 32 bits (65535 x 65535 cells of 2 bytes).
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint64_t)cmd->m_columns * cmd->m_rows * 2;
+          if ((uint64_t)len >= total_size) {
+            // The whole block is applied at once, so a level screen needs a single command.
+            set_tile_array_block(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows, cmd->m_data);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 93: {
+        auto cmd = &cu->m_93_Copy_tile_region_in_Tile_Array;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          copy_tile_array_region(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows,
+            cmd->m_dcolumn, cmd->m_drow, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
       case 100: {
         auto cmd = &cu->m_100_Create_primitive_Tile_Map;
         if (m_incoming_command.size() == sizeof(*cmd)) {
@@ -1771,6 +2150,107 @@ bool DiManager::handle_otf_cmd() {
         }
       } break;
 
+      case 111: {
+        auto cmd = &cu->m_111_Set_Tile_Map_scroll_position;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_tile_map_scroll_position(cmd->m_id, cmd->m_x, cmd->m_y);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 112: {
+        auto cmd = &cu->m_112_Set_Tile_Map_line_table;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint32_t)cmd->m_n * 4;
+          if (len >= total_size) {
+            set_tile_map_line_table(cmd->m_id, cmd->m_s, cmd->m_n, cmd->m_data);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 113: {
+        auto cmd = &cu->m_113_Set_tile_animation_in_Tile_Map;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint32_t)cmd->m_n * 2;
+          if (len >= total_size) {
+            set_tile_map_tile_animation(cmd->m_id, cmd->m_bmid, cmd->m_ticks, cmd->m_data, cmd->m_n);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 114: {
+        auto cmd = &cu->m_114_Set_tile_flip_in_Tile_Map;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_tile_map_tile_flip(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 115: {
+        auto cmd = &cu->m_115_Fill_tile_region_in_Tile_Map;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          fill_tile_map_region(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows, cmd->m_bmid);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 116: {
+        auto cmd = &cu->m_116_Set_tile_block_in_Tile_Map;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          // The block size can exceed 32 bits (65535 x 65535 cells of 2 bytes).
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint64_t)cmd->m_columns * cmd->m_rows * 2;
+          if ((uint64_t)len >= total_size) {
+            // The whole block is applied at once, so a level screen needs a single command.
+            set_tile_map_block(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows, cmd->m_data);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 117: {
+        auto cmd = &cu->m_117_Copy_tile_region_in_Tile_Map;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          copy_tile_map_region(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows,
+            cmd->m_dcolumn, cmd->m_drow, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 118: {
+        auto cmd = &cu->m_118_Set_Tile_Map_world_size;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_tile_map_world_size(cmd->m_id, cmd->m_columns, cmd->m_rows);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 119: {
+        auto cmd = &cu->m_119_Set_world_tile_block_in_Tile_Map;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          // The block size can exceed 32 bits (65535 x 65535 cells of 2 bytes).
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint64_t)cmd->m_columns * cmd->m_rows * 2;
+          if ((uint64_t)len >= total_size) {
+            set_tile_map_world_block(cmd->m_id, cmd->m_column, cmd->m_row, cmd->m_columns, cmd->m_rows, cmd->m_data);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
       case 120: {
         auto cmd = &cu->m_120_Create_primitive_Solid_Bitmap;
         if (m_incoming_command.size() == sizeof(*cmd)) {
@@ -1957,6 +2437,24 @@ bool DiManager::handle_otf_cmd() {
         }
       } break;
 
+      case 138: {
+        auto cmd = &cu->m_138_Set_bitmap_animation;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_bitmap_animation(cmd->m_id, cmd->m_h, cmd->m_n, cmd->m_ticks, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 139: {
+        auto cmd = &cu->m_139_Select_bitmap_memory;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          select_bitmap_memory(cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
       case 140: {
         auto cmd = &cu->m_140_Create_primitive_Group;
         if (m_incoming_command.size() == sizeof(*cmd)) {
@@ -1966,16 +2464,83 @@ bool DiManager::handle_otf_cmd() {
         }
       } break;
 
-      case 150: {
-        auto cmd = &cu->m_150_Create_primitive_Terminal;
+      case 141: {
+        auto cmd = &cu->m_141_Set_bitmap_pixels_compressed;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint32_t)cmd->m_n;
+          if (len >= total_size) {
+            // The whole compressed block is decoded at once, directly into the bitmap.
+            set_bitmap_pixels_compressed(cmd->m_id, cmd->m_x, cmd->m_y, cmd->m_data, cmd->m_n);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
       } break;
 
-      case 151: {
-        auto cmd = &cu->m_151_Select_Active_Terminal;
+      case 142: {
+        auto cmd = &cu->m_142_Create_primitive_Palette_Bitmap;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          create_palette_bitmap(cmd->m_id, cmd->m_pid, cmd->m_flags, cmd->m_w, cmd->m_h, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
-      case 152: {
-        auto cmd = &cu->m_152_Define_Terminal_Character;
+      case 143: {
+        auto cmd = &cu->m_143_Set_palette_bitmap_colors;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_colors)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_colors) + (uint32_t)cmd->m_n;
+          if (len >= total_size) {
+            set_palette_bitmap_colors(cmd->m_id, cmd->m_i0, cmd->m_colors, cmd->m_n);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 144: {
+        auto cmd = &cu->m_144_Set_palette_bitmap_pixels;
+        auto len = m_incoming_command.size();
+        if (len >= sizeof(*cmd) - sizeof(cmd->m_data)) {
+          auto total_size = sizeof(*cmd) - sizeof(cmd->m_data) + (uint32_t)cmd->m_n;
+          if (len >= total_size) {
+            set_palette_bitmap_pixels(cmd->m_id, cmd->m_x, cmd->m_y, cmd->m_data, cmd->m_n);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
+      } break;
+
+      case 145: {
+        auto cmd = &cu->m_145_Set_bitmap_flip;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_bitmap_flip(cmd->m_id, cmd->m_mode);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 146: {
+        auto cmd = &cu->m_146_Set_Tile_Map_world_scroll_position;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_tile_map_world_scroll_position(cmd->m_id, cmd->m_wx, cmd->m_wy);
+          m_incoming_command.clear();
+          return true;
+        }
+      } break;
+
+      case 150: {
+        auto cmd = &cu->m_150_Create_primitive_Terminal;
+      } break;
+
+      case 151: {
+        auto cmd = &cu->m_151_Select_Active_Terminal;
+      } break;
+
+      case 152: {
+        auto cmd = &cu->m_152_Define_Terminal_Character;
       } break;
 
       case 153: {
@@ -1984,78 +2549,193 @@ bool DiManager::handle_otf_cmd() {
 
       case 200: {
         auto cmd = &cu->m_200_Create_primitive_Render_3D_Scene;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          create_render_3d_scene(cmd);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 201: {
         auto cmd = &cu->m_201_Define_Mesh_Vertices;
+        auto len = m_incoming_command.size();
+        auto header_size = sizeof(*cmd) - sizeof(cmd->m_x0) - sizeof(cmd->m_y0) - sizeof(cmd->m_z0);
+        if (len >= header_size) {
+          auto total_size = header_size + (uint32_t)cmd->m_n * 6;
+          if (len >= total_size) {
+            define_render_mesh_vertices(cmd->m_id, cmd->m_mid, cmd->m_n, (const uint8_t*)&cmd->m_x0);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
       } break;
 
       case 202: {
         auto cmd = &cu->m_202_Set_Mesh_Vertex_Indices;
+        auto len = m_incoming_command.size();
+        auto header_size = sizeof(*cmd) - sizeof(cmd->m_i0);
+        if (len >= header_size) {
+          auto total_size = header_size + (uint32_t)cmd->m_n * 2;
+          if (len >= total_size) {
+            set_render_mesh_vertex_indices(cmd->m_id, cmd->m_mid, cmd->m_n, (const uint8_t*)&cmd->m_i0);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
       } break;
 
       case 203: {
         auto cmd = &cu->m_203_Define_Texture_Coordinates;
+        auto len = m_incoming_command.size();
+        auto header_size = sizeof(*cmd) - sizeof(cmd->m_u0) - sizeof(cmd->m_v0);
+        if (len >= header_size) {
+          auto total_size = header_size + (uint32_t)cmd->m_n * 4;
+          if (len >= total_size) {
+            define_render_texture_coordinates(cmd->m_id, cmd->m_mid, cmd->m_n, (const uint8_t*)&cmd->m_u0);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
       } break;
 
       case 204: {
         auto cmd = &cu->m_204_Set_Texture_Coordinate_Indices;
+        auto len = m_incoming_command.size();
+        auto header_size = sizeof(*cmd) - sizeof(cmd->m_i0);
+        if (len >= header_size) {
+          auto total_size = header_size + (uint32_t)cmd->m_n * 2;
+          if (len >= total_size) {
+            set_render_texture_coordinate_indices(cmd->m_id, cmd->m_mid, cmd->m_n, (const uint8_t*)&cmd->m_i0);
+            m_incoming_command.clear();
+            return true;
+          }
+        }
       } break;
 
       case 205: {
         auto cmd = &cu->m_205_Create_Object;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          create_render_object(cmd->m_id, cmd->m_oid, cmd->m_mid, cmd->m_bmid);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 206: {
         auto cmd = &cu->m_206_Set_Object_X_Scale_Factor;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_scale(cmd->m_id, cmd->m_oid, 1, cmd->m_scalex, 0, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 207: {
         auto cmd = &cu->m_207_Set_Object_Y_Scale_Factor;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_scale(cmd->m_id, cmd->m_oid, 2, 0, cmd->m_scaley, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 208: {
         auto cmd = &cu->m_208_Set_Object_Z_Scale_Factor;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_scale(cmd->m_id, cmd->m_oid, 4, 0, 0, cmd->m_scalez);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 209: {
         auto cmd = &cu->m_209_Set_Object_XYZ_Scale_Factors;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_scale(cmd->m_id, cmd->m_oid, 7, cmd->m_scalex, cmd->m_scaley, cmd->m_scalez);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 210: {
         auto cmd = &cu->m_210_Set_Object_X_Rotation_Angle;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_rotation(cmd->m_id, cmd->m_oid, 1, cmd->m_anglex, 0, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 211: {
         auto cmd = &cu->m_211_Set_Object_Y_Rotation_Angle;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_rotation(cmd->m_id, cmd->m_oid, 2, 0, cmd->m_angley, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 212: {
         auto cmd = &cu->m_212_Set_Object_Z_Rotation_Angle;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_rotation(cmd->m_id, cmd->m_oid, 4, 0, 0, cmd->m_anglez);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 213: {
         auto cmd = &cu->m_213_Set_Object_XYZ_Rotation_Angles;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_rotation(cmd->m_id, cmd->m_oid, 7, cmd->m_anglex, cmd->m_angley, cmd->m_anglez);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 214: {
         auto cmd = &cu->m_214_Set_Object_X_Translation_Distance;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_translation(cmd->m_id, cmd->m_oid, 1, cmd->m_distx, 0, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 215: {
         auto cmd = &cu->m_215_Set_Object_Y_Translation_Distance;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_translation(cmd->m_id, cmd->m_oid, 2, 0, cmd->m_disty, 0);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 216: {
         auto cmd = &cu->m_216_Set_Object_Z_Translation_Distance;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_translation(cmd->m_id, cmd->m_oid, 4, 0, 0, cmd->m_distz);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 217: {
         auto cmd = &cu->m_217_Set_Object_XYZ_Translation_Distances;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          set_render_object_translation(cmd->m_id, cmd->m_oid, 7, cmd->m_distx, cmd->m_disty, cmd->m_distz);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       case 218: {
         auto cmd = &cu->m_218_Render_To_Bitmap;
+        if (m_incoming_command.size() == sizeof(*cmd)) {
+          render_to_bitmap(cmd->m_id);
+          m_incoming_command.clear();
+          return true;
+        }
       } break;
 
       default: {
@@ -2214,41 +2894,119 @@ void DiManager::send_general_poll(uint8_t b) {
 	initialised = true;	
 }
 
+// Send pairs of colliding primitive IDs back to MOS
+//
+void DiManager::send_collisions(const uint16_t* ids, uint32_t num_pairs) {
+	byte packet[1 + MAX_COLLISION_PAIRS * 4];
+	packet[0] = (byte) num_pairs;
+	for (uint32_t i = 0; i < num_pairs * 2; i++) {
+		packet[1 + i * 2] = (byte) (ids[i] & 0xFF);
+		packet[2 + i * 2] = (byte) (ids[i] >> 8);
+	}
+	send_packet(PACKET_OTF_COLLISION, (byte) (1 + num_pairs * 4), packet);
+}
+
 void DiManager::set_primitive_flags(uint16_t id, uint16_t flags) {
   DiPrimitive* prim; if (!(prim = (DiPrimitive*)get_safe_primitive(id))) return;
   auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
   auto chg_flags = flags & PRIM_FLAGS_CHANGEABLE;
   auto new_flags = (old_flags & ~PRIM_FLAGS_CHANGEABLE) | chg_flags;
   prim->set_flags(new_flags);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::move_primitive_absolute(uint16_t id, int32_t x, int32_t y) {
   DiPrimitive* prim; if (!(prim = (DiPrimitive*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
   prim->set_relative_position(x, y);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::move_primitive_relative(uint16_t id, int32_t x, int32_t y) {
   DiPrimitive* prim; if (!(prim = (DiPrimitive*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
   auto x2 = prim->get_relative_x() + x;
   auto y2 = prim->get_relative_y() + y;
   prim->set_relative_position(x2, y2);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);  
+  recompute_primitive(prim);
+}
+
+void DiManager::set_primitive_auto_motion(uint16_t id, int32_t dx, int32_t dy, uint16_t moves) {
+  DiPrimitive* prim; if (!(prim = (DiPrimitive*)get_safe_primitive(id))) return;
+  prim->set_relative_deltas(dx, dy, (moves == 0xFFFF) ? (uint32_t)-1 : (uint32_t)moves);
+}
+
+void DiManager::set_primitive_position_and_auto_motion(uint16_t id, int32_t x, int32_t y,
+                            int32_t dx, int32_t dy, uint16_t moves) {
+  move_primitive_absolute(id, x, y);
+  set_primitive_auto_motion(id, dx, dy, moves);
+}
+
+void DiManager::set_primitive_collision_groups(uint16_t id, uint16_t groups, uint16_t mask) {
+  DiPrimitive* prim; if (!(prim = (DiPrimitive*)get_safe_primitive(id))) return;
+  for (auto collider = m_colliders.begin(); collider != m_colliders.end(); ++collider) {
+    if (collider->m_id == id) {
+      if (groups || mask) {
+        collider->m_groups = groups;
+        collider->m_mask = mask;
+      } else {
+        m_colliders.erase(collider);
+      }
+      return;
+    }
+  }
+  if (groups || mask) {
+    DiCollider collider;
+    collider.m_id = id;
+    collider.m_groups = groups;
+    collider.m_mask = mask;
+    m_colliders.push_back(collider);
+  }
+}
+
+bool DiManager::is_raster_target_id(uint16_t id) {
+  for (auto action = m_raster_program.begin(); action != m_raster_program.end(); ++action) {
+    if (action->m_id == id) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DiManager::set_raster_program(uint32_t num_actions, const uint8_t* data) {
+  // Primitives hidden by the old program become visible again.
+  for (auto action = m_raster_program.begin(); action != m_raster_program.end(); ++action) {
+    if (action->m_id <= LAST_PRIMITIVE_ID && m_primitives[action->m_id]) {
+      m_primitives[action->m_id]->set_raster_hidden(false);
+      m_primitives[action->m_id]->set_raster_target(false);
+    }
+  }
+
+  m_raster_program.clear();
+  m_raster_index = 0;
+  while (num_actions--) {
+    DiRasterAction action;
+    action.m_line = data[0] | ((uint16_t)data[1] << 8);
+    action.m_id = data[2] | ((uint16_t)data[3] << 8);
+    action.m_value = data[4] | ((uint16_t)data[5] << 8);
+    action.m_action = data[6];
+    data += RASTER_ACTION_SIZE;
+    if (action.m_id > LAST_PRIMITIVE_ID) {
+      continue;
+    }
+
+    // The primitive may be created later; a slice on a primitive that is not a bitmap does nothing.
+    auto prim = m_primitives[action.m_id];
+    m_raster_program.push_back(action);
+    if (prim) {
+      prim->set_raster_target(true);
+    }
+  }
+
+  // Actions on the same line keep the order in which they were given.
+  std::stable_sort(m_raster_program.begin(), m_raster_program.end(),
+    [](const DiRasterAction& a, const DiRasterAction& b) { return a.m_line < b.m_line; });
+
+  // The primitives named by the program no longer hide (or now hide) what is beneath them.
+  cull_groups(0, ACT_LINES - 1);
 }
 
 void DiManager::delete_primitive(uint16_t id) {
@@ -2297,15 +3055,30 @@ DiPrimitive* DiManager::create_solid_ellipse(uint16_t id, uint16_t parent, uint1
     return finish_create(id, flags, prim, parent_prim);
 }
 
+DiPaletteBitmap* DiManager::create_palette_bitmap(uint16_t id, uint16_t parent, uint16_t flags,
+                        uint32_t width, uint32_t height, uint8_t bits_per_pixel) {
+    if (!validate_id(id)) return NULL;
+    DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
+    if (bits_per_pixel != 2 && bits_per_pixel != 4) return NULL;
+
+    auto prim = new DiPaletteBitmap(width, height, flags, bits_per_pixel);
+
+    finish_create(id, flags, prim, parent_prim);
+    return prim;
+}
+
 DiBitmap* DiManager::create_solid_bitmap(uint16_t id, uint16_t parent, uint16_t flags,
                         uint32_t width, uint32_t height) {
     if (!validate_id(id)) return NULL;
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
 
     flags |= PRIM_FLAGS_X_SRC|PRIM_FLAGS_ALL_SAME;
-    auto prim = new DiBitmap(width, height, flags);
+    auto prim = new DiBitmap(width, height, flags, m_bitmap_memory);
 
     finish_create(id, flags, prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
@@ -2315,10 +3088,13 @@ DiBitmap* DiManager::create_masked_bitmap(uint16_t id, uint16_t parent, uint16_t
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
 
     flags |= PRIM_FLAGS_X_SRC;
-    auto prim = new DiBitmap(width, height, flags);
+    auto prim = new DiBitmap(width, height, flags, m_bitmap_memory);
     prim->set_transparent_color(color);
 
     finish_create(id, flags, prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
@@ -2328,43 +3104,55 @@ DiBitmap* DiManager::create_transparent_bitmap(uint16_t id, uint16_t parent, uin
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
 
     flags |= PRIM_FLAGS_X_SRC;
-    auto prim = new DiBitmap(width, height, flags);
+    auto prim = new DiBitmap(width, height, flags, m_bitmap_memory);
     prim->set_transparent_color(color);
 
     finish_create(id, flags, prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
 DiBitmap* DiManager::create_reference_solid_bitmap(uint16_t id, uint16_t parent, uint16_t flags, uint16_t bmid) {
     if (!validate_id(id)) return NULL;
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
-    DiBitmap* ref_prim; if (!(ref_prim = (DiBitmap*) get_safe_primitive(bmid))) return NULL;
+    DiBitmap* ref_prim; if (!(ref_prim = get_safe_bitmap(bmid))) return NULL;
 
     auto prim = new DiBitmap(flags, ref_prim);
 
-    finish_create(id, flags, prim, parent_prim);
+    finish_create(id, prim->get_flags(), prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
 DiBitmap* DiManager::create_reference_masked_bitmap(uint16_t id, uint16_t parent, uint16_t flags, uint16_t bmid) {
     if (!validate_id(id)) return NULL;
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
-    DiBitmap* ref_prim; if (!(ref_prim = (DiBitmap*) get_safe_primitive(bmid))) return NULL;
+    DiBitmap* ref_prim; if (!(ref_prim = get_safe_bitmap(bmid))) return NULL;
 
     auto prim = new DiBitmap(flags, ref_prim);
 
-    finish_create(id, flags, prim, parent_prim);
+    finish_create(id, prim->get_flags(), prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
 DiBitmap* DiManager::create_reference_transparent_bitmap(uint16_t id, uint16_t parent, uint16_t flags, uint16_t bmid) {
     if (!validate_id(id)) return NULL;
     DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(parent))) return NULL;
-    DiBitmap* ref_prim; if (!(ref_prim = (DiBitmap*) get_safe_primitive(bmid))) return NULL;
+    DiBitmap* ref_prim; if (!(ref_prim = get_safe_bitmap(bmid))) return NULL;
 
     auto prim = new DiBitmap(flags, ref_prim);
 
-    finish_create(id, flags, prim, parent_prim);
+    finish_create(id, prim->get_flags(), prim, parent_prim);
+    if (prim->is_in_psram()) {
+      m_psram_bitmaps.push_back(prim);
+    }
     return prim;
 }
 
@@ -2377,14 +3165,18 @@ DiTileBitmap* DiManager::create_solid_bitmap_for_tile_array(uint16_t id, uint16_
 DiTileBitmap* DiManager::create_masked_bitmap_for_tile_array(uint16_t id, uint16_t bm_id, uint8_t color) {
     DiTileArray* prim; if (!(prim = (DiTileArray*)get_safe_primitive(id))) return NULL;
     auto bitmap = prim->create_bitmap(bm_id);
-    bitmap->set_transparent_color(color);
+    if (bitmap) {
+      bitmap->set_transparent_color(color);
+    }
     return bitmap;
 }
 
 DiTileBitmap* DiManager::create_transparent_bitmap_for_tile_array(uint16_t id, uint16_t bm_id, uint8_t color) {
     DiTileArray* prim; if (!(prim = (DiTileArray*)get_safe_primitive(id))) return NULL;
     auto bitmap = prim->create_bitmap(bm_id);
-    bitmap->set_transparent_color(color);
+    if (bitmap) {
+      bitmap->set_transparent_color(color);
+    }
     return bitmap;
 }
 
@@ -2397,14 +3189,18 @@ DiTileBitmap* DiManager::create_solid_bitmap_for_tile_map(uint16_t id, uint16_t
 DiTileBitmap* DiManager::create_masked_bitmap_for_tile_map(uint16_t id, uint16_t bm_id, uint8_t color) {
     DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return NULL;
     auto bitmap = prim->create_bitmap(bm_id);
-    bitmap->set_transparent_color(color);
+    if (bitmap) {
+      bitmap->set_transparent_color(color);
+    }
     return bitmap;
 }
 
 DiTileBitmap* DiManager::create_transparent_bitmap_for_tile_map(uint16_t id, uint16_t bm_id, uint8_t color) {
     DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return NULL;
     auto bitmap = prim->create_bitmap(bm_id);
-    bitmap->set_transparent_color(color);
+    if (bitmap) {
+      bitmap->set_transparent_color(color);
+    }
     return bitmap;
 }
 
@@ -2453,80 +3249,101 @@ DiPrimitive* DiManager::create_primitive_group(OtfCmd_140_Create_primitive_Group
     return finish_create(cmd->m_id, cmd->m_flags, prim, parent_prim);
 }
 
+DiRender* DiManager::create_render_3d_scene(OtfCmd_200_Create_primitive_Render_3D_Scene* cmd) {
+    if (!validate_id(cmd->m_id)) return NULL;
+    DiPrimitive* parent_prim; if (!(parent_prim = get_safe_primitive(cmd->m_pid))) return NULL;
+
+    auto prim = new DiRender(cmd->m_w, cmd->m_h, cmd->m_flags);
+    prim->set_relative_position(cmd->m_x, cmd->m_y);
+
+    finish_create(cmd->m_id, cmd->m_flags, prim, parent_prim);
+    return prim;
+}
+
 void DiManager::slice_solid_bitmap_absolute(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::slice_masked_bitmap_absolute(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::slice_transparent_bitmap_absolute(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::slice_solid_bitmap_relative(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   auto x2 = prim->get_relative_x() + x;
   auto y2 = prim->get_relative_y() + y;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::slice_masked_bitmap_relative(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   auto x2 = prim->get_relative_x() + x;
   auto y2 = prim->get_relative_y() + y;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group);
+  recompute_primitive(prim);
 }
 
 void DiManager::slice_transparent_bitmap_relative(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
-  auto old_flags = prim->get_flags();
-  int32_t old_min_group = -1, old_max_group = -1;
-  if (old_flags & PRIM_FLAGS_CAN_DRAW) {
-    prim->get_vertical_group_range(old_min_group, old_max_group);
-  }
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   auto x2 = prim->get_relative_x() + x;
   auto y2 = prim->get_relative_y() + y;
   prim->set_slice_position(x, y, start_line, height);
-  recompute_primitive(prim, old_flags, old_min_group, old_max_group); 
+  recompute_primitive(prim);
+}
+
+void DiManager::set_bitmap_animation(uint16_t id, uint32_t frame_height, uint32_t num_frames,
+                            uint32_t frames_per_step, uint8_t mode) {
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
+  prim->set_animation(frame_height, num_frames, frames_per_step, mode);
+  recompute_primitive(prim);
+
+  auto anim = std::find(m_animated_bitmaps.begin(), m_animated_bitmaps.end(), prim);
+  if (prim->is_animated()) {
+    if (anim == m_animated_bitmaps.end()) {
+      m_animated_bitmaps.push_back(prim);
+    }
+  } else if (anim != m_animated_bitmaps.end()) {
+    m_animated_bitmaps.erase(anim);
+  }
+}
+
+void DiManager::select_bitmap_memory(uint8_t memory) {
+  m_bitmap_memory = memory;
+}
+
+void DiManager::set_bitmap_pixels_compressed(uint16_t id, int32_t x, int32_t y, const uint8_t* data, uint32_t size) {
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
+  prim->decode_pixels(x, y, data, size);
+}
+
+void DiManager::set_bitmap_flip(uint16_t id, uint8_t flip) {
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
+  prim->set_flip(flip);
+}
+
+void DiManager::set_palette_bitmap_colors(uint16_t id, uint32_t index, const uint8_t* colors, uint32_t num_colors) {
+  DiPaletteBitmap* prim; if (!(prim = get_safe_palette_bitmap(id))) return;
+  prim->set_palette_colors(index, colors, num_colors);
+}
+
+void DiManager::set_palette_bitmap_pixels(uint16_t id, int32_t x, int32_t y, const uint8_t* data, uint32_t size) {
+  DiPaletteBitmap* prim; if (!(prim = get_safe_palette_bitmap(id))) return;
+  prim->set_packed_pixels(x, y, data, size);
 }
 
 void DiManager::set_solid_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_t color, int16_t nth) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   int32_t px = x + nth;
   int32_t py = y;
   while (px >= prim->get_width()) {
@@ -2537,7 +3354,7 @@ void DiManager::set_solid_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_
 }
 
 void DiManager::set_masked_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_t color, int16_t nth) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   int32_t px = x + nth;
   int32_t py = y;
   while (px >= prim->get_width()) {
@@ -2548,7 +3365,7 @@ void DiManager::set_masked_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8
 }
 
 void DiManager::set_transparent_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_t color, int16_t nth) {
-  DiBitmap* prim; if (!(prim = (DiBitmap*)get_safe_primitive(id))) return;
+  DiBitmap* prim; if (!(prim = get_safe_bitmap(id))) return;
   int32_t px = x + nth;
   int32_t py = y;
   while (px >= prim->get_width()) {
@@ -2623,7 +3440,172 @@ void DiManager::set_tile_array_bitmap_id(uint16_t id, uint16_t col, uint16_t row
   prim->set_tile(col, row, bm_id);
 }
 
+void DiManager::fill_tile_array_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, uint16_t bm_id) {
+  DiTileArray* prim; if (!(prim = (DiTileArray*)get_safe_primitive(id))) return;
+  if (bm_id) {
+    prim->set_tiles(col, row, bm_id, columns, rows);
+  } else {
+    prim->unset_tiles(col, row, columns, rows);
+  }
+}
+
+void DiManager::set_tile_array_block(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids) {
+  DiTileArray* prim; if (!(prim = (DiTileArray*)get_safe_primitive(id))) return;
+  prim->set_tile_block(col, row, columns, rows, bm_ids);
+}
+
+void DiManager::copy_tile_array_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows,
+                            int16_t dst_col, int16_t dst_row, uint8_t mode) {
+  DiTileArray* prim; if (!(prim = (DiTileArray*)get_safe_primitive(id))) return;
+  prim->copy_tiles(col, row, columns, rows, dst_col, dst_row, (mode & 1) != 0);
+}
+
 void DiManager::set_tile_map_bitmap_id(uint16_t id, uint16_t col, uint16_t row, uint16_t bm_id) {
   DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
   prim->set_tile(col, row, bm_id);
 }
+
+void DiManager::fill_tile_map_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, uint16_t bm_id) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  if (bm_id) {
+    prim->set_tiles(col, row, bm_id, columns, rows);
+  } else {
+    prim->unset_tiles(col, row, columns, rows);
+  }
+}
+
+void DiManager::set_tile_map_block(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_tile_block(col, row, columns, rows, bm_ids);
+}
+
+void DiManager::copy_tile_map_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows,
+                            int16_t dst_col, int16_t dst_row, uint8_t mode) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->copy_tiles(col, row, columns, rows, dst_col, dst_row, (mode & 1) != 0);
+}
+
+void DiManager::set_tile_map_tile_flip(uint16_t id, uint16_t col, uint16_t row, uint8_t flip) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  // The command bits match those of bitmaps (1 = horizontal, 2 = vertical).
+  uint16_t tile_flip = 0;
+  if (flip & BITMAP_FLIP_H) {
+    tile_flip |= TILE_FLIP_H;
+  }
+  if (flip & BITMAP_FLIP_V) {
+    tile_flip |= TILE_FLIP_V;
+  }
+  prim->set_tile_flip(col, row, tile_flip);
+}
+
+void DiManager::set_tile_map_scroll_position(uint16_t id, int32_t x, int32_t y) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_scroll_position(x, y);
+}
+
+void DiManager::set_tile_map_line_table(uint16_t id, uint32_t first_line, uint32_t num_lines, const uint8_t* entries) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_line_table(first_line, num_lines, entries);
+}
+
+void DiManager::set_tile_map_world_size(uint16_t id, uint32_t world_columns, uint32_t world_rows) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_world_size(world_columns, world_rows);
+
+  auto world_map = std::find(m_world_tile_maps.begin(), m_world_tile_maps.end(), prim);
+  if (prim->is_world()) {
+    if (world_map == m_world_tile_maps.end()) {
+      m_world_tile_maps.push_back(prim);
+    }
+  } else if (world_map != m_world_tile_maps.end()) {
+    m_world_tile_maps.erase(world_map);
+  }
+}
+
+void DiManager::set_tile_map_world_block(uint16_t id, int32_t col, int32_t row, int32_t columns, int32_t rows, const uint8_t* bm_ids) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_world_tile_block(col, row, columns, rows, bm_ids);
+}
+
+void DiManager::set_tile_map_world_scroll_position(uint16_t id, int32_t x, int32_t y) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  prim->set_world_scroll_position(x, y);
+}
+
+void DiManager::set_tile_map_tile_animation(uint16_t id, uint16_t bm_id, uint32_t frames_per_step,
+                            const uint8_t* frame_ids, uint32_t num_frames) {
+  DiTileMap* prim; if (!(prim = (DiTileMap*)get_safe_primitive(id))) return;
+  std::vector<DiTileBitmapID> ids;
+  while (num_frames--) {
+    ids.push_back(frame_ids[0] | ((DiTileBitmapID)frame_ids[1] << 8));
+    frame_ids += 2;
+  }
+  prim->set_tile_animation(bm_id, ids, frames_per_step);
+
+  auto anim = std::find(m_animated_tile_maps.begin(), m_animated_tile_maps.end(), prim);
+  if (prim->is_animated()) {
+    if (anim == m_animated_tile_maps.end()) {
+      m_animated_tile_maps.push_back(prim);
+    }
+  } else if (anim != m_animated_tile_maps.end()) {
+    m_animated_tile_maps.erase(anim);
+  }
+}
+
+void DiManager::define_render_mesh_vertices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* coords) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  prim->define_mesh_vertices(mid, n, coords);
+}
+
+void DiManager::set_render_mesh_vertex_indices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* indices) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  prim->set_mesh_vertex_indices(mid, n, indices);
+}
+
+void DiManager::define_render_texture_coordinates(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* coords) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  prim->define_texture_coordinates(mid, n, coords);
+}
+
+void DiManager::set_render_texture_coordinate_indices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* indices) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  prim->set_texture_coordinate_indices(mid, n, indices);
+}
+
+void DiManager::create_render_object(uint16_t id, uint16_t oid, uint16_t mid, uint16_t bmid) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  DiBitmap* texture = NULL;
+  if (bmid) {
+    auto tex_prim = get_safe_primitive(bmid);
+    if (!tex_prim || !(texture = tex_prim->as_bitmap())) return;
+  }
+  prim->create_object(oid, mid, texture);
+}
+
+void DiManager::set_render_object_scale(uint16_t id, uint16_t oid, uint8_t mask,
+                            uint16_t scalex, uint16_t scaley, uint16_t scalez) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  prim->set_object_scale(oid, mask, (float)scalex / 256.0f, (float)scaley / 256.0f, (float)scalez / 256.0f);
+}
+
+void DiManager::set_render_object_rotation(uint16_t id, uint16_t oid, uint8_t mask,
+                            int16_t anglex, int16_t angley, int16_t anglez) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  const float factor = 6.2831853f / 32767.0f; // 2PI radians at full scale
+  prim->set_object_rotation(oid, mask, (float)anglex * factor, (float)angley * factor, (float)anglez * factor);
+}
+
+void DiManager::set_render_object_translation(uint16_t id, uint16_t oid, uint8_t mask,
+                            int16_t distx, int16_t disty, int16_t distz) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  const float factor = 256.0f / 32767.0f;
+  prim->set_object_translation(oid, mask, (float)distx * factor, (float)disty * factor, (float)distz * factor);
+}
+
+void DiManager::render_to_bitmap(uint16_t id) {
+  DiRender* prim; if (!(prim = get_safe_render(id))) return;
+  // Repeated requests before the scene is drawn are merged into one.
+  if (std::find(m_pending_renders.begin(), m_pending_renders.end(), prim) == m_pending_renders.end()) {
+    m_pending_renders.push_back(prim);
+  }
+}
@@ -31,12 +31,53 @@
 #include "di_tile_map.h"
 #include "di_render.h"
 #include "di_solid_rectangle.h"
+#include "di_palette_bitmap.h"
 #include "di_commands.h"
 
 typedef void (*DiVoidCallback)();
 
+// Information about a primitive in a subtree whose geometry is being recomputed,
+// saved before the change, so that its paint groups can be adjusted afterward,
+// and its code regenerated only when necessary.
+typedef struct {
+  DiPrimitive*  m_prim;
+  int32_t       m_old_draw_x;
+  int32_t       m_old_draw_x_offset;
+  int32_t       m_old_draw_width;
+  int32_t       m_old_first_group;
+  int32_t       m_old_last_group;
+  int32_t       m_new_first_group;
+  int32_t       m_new_last_group;
+} DiSubtreeMember;
+
+// Collision detection settings for a primitive. A primitive collides with
+// another primitive when its mask has any bit in common with the groups of
+// the other primitive.
+typedef struct {
+  uint16_t      m_id;
+  uint16_t      m_groups;
+  uint16_t      m_mask;
+} DiCollider;
+
+// An action in the raster program, performed when drawing reaches the given screen line.
+// The program runs again in every frame, so its effects can differ on each part of the screen.
+typedef struct {
+  uint16_t      m_line;
+  uint16_t      m_id;
+  uint16_t      m_value;
+  uint8_t       m_action;
+} DiRasterAction;
+
+#define RASTER_SET_COLOR           0   // set the color of a primitive (rectangle, line, etc.)
+#define RASTER_HIDE                1   // stop painting a primitive
+#define RASTER_SHOW                2   // resume painting a primitive
+#define RASTER_SET_SLICE           3   // set the first visible line of a bitmap
+#define RASTER_ACTION_SIZE         7   // bytes per action in the command data
+
 #define INCOMING_DATA_BUFFER_SIZE  2048
 #define INCOMING_COMMAND_SIZE      24
+#define MAX_COLLISION_PAIRS        60  // per packet sent to the EZ80
+#define COLLISION_ENDED            0x8000 // set in the second ID of a pair that stopped colliding
 
 class DiManager {
     public:
@@ -123,6 +164,9 @@ class DiManager {
 
     DiBitmap* create_reference_transparent_bitmap(uint16_t id, uint16_t parent, uint16_t flags, uint16_t bmid);
 
+    DiPaletteBitmap* create_palette_bitmap(uint16_t id, uint16_t parent, uint16_t flags,
+                            uint32_t width, uint32_t height, uint8_t bits_per_pixel);
+
     DiTileBitmap* create_solid_bitmap_for_tile_array(uint16_t id, uint16_t bm_id);
 
     DiTileBitmap* create_masked_bitmap_for_tile_array(uint16_t id, uint16_t bm_id, uint8_t color);
@@ -145,6 +189,7 @@ class DiManager {
                             uint32_t width, uint32_t height, uint8_t color);
 
     DiPrimitive* create_primitive_group(OtfCmd_140_Create_primitive_Group* cmd);
+    DiRender* create_render_3d_scene(OtfCmd_200_Create_primitive_Render_3D_Scene* cmd);
 
     // Set the flags for an existing primitive.
     void set_primitive_flags(uint16_t id, uint16_t flags);
@@ -155,6 +200,26 @@ class DiManager {
     // Move an existing primitive to a relative position.
     void move_primitive_relative(uint16_t id, int32_t x, int32_t y);
 
+    // Set the automatic motion of an existing primitive. The deltas are 16.16 fixed-point
+    // values, applied once per frame, for the given number of moves (0xFFFF = indefinitely).
+    void set_primitive_auto_motion(uint16_t id, int32_t dx, int32_t dy, uint16_t moves);
+
+    // Move an existing primitive to an absolute position, and set its automatic motion.
+    void set_primitive_position_and_auto_motion(uint16_t id, int32_t x, int32_t y,
+                            int32_t dx, int32_t dy, uint16_t moves);
+
+    // Set the collision groups of an existing primitive (which groups it belongs to), and
+    // its collision mask (which groups it collides with). Zero for both stops detection.
+    void set_primitive_collision_groups(uint16_t id, uint16_t groups, uint16_t mask);
+
+    // Replace the raster program with the given actions, each of which is a line (2 bytes),
+    // a primitive ID (2 bytes), a value (2 bytes), and an action code (1 byte).
+    // Using 0 actions removes the raster program.
+    void set_raster_program(uint32_t num_actions, const uint8_t* data);
+
+    // Determine whether the raster program has any actions for the given primitive ID.
+    bool is_raster_target_id(uint16_t id);
+
     // Delete an existing primitive.
     void delete_primitive(uint16_t id);
 
@@ -171,6 +236,25 @@ class DiManager {
     void slice_masked_bitmap_relative(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height);
     void slice_transparent_bitmap_relative(uint16_t id, int32_t x, int32_t y, int32_t start_line, int32_t height);
 
+    // Setup automatic animation of an existing bitmap, using frames stacked vertically in the bitmap.
+    void set_bitmap_animation(uint16_t id, uint32_t frame_height, uint32_t num_frames,
+                            uint32_t frames_per_step, uint8_t mode);
+
+    // Select the type of memory (internal RAM or PSRAM) for the pixels of bitmaps created afterward.
+    void select_bitmap_memory(uint8_t memory);
+
+    // Decode compressed pixel data into an existing bitmap, starting at the given position.
+    void set_bitmap_pixels_compressed(uint16_t id, int32_t x, int32_t y, const uint8_t* data, uint32_t size);
+
+    // Flip an existing bitmap horizontally and/or vertically, without changing its pixels.
+    void set_bitmap_flip(uint16_t id, uint8_t flip);
+
+    // Set colors in the palette of an existing palette bitmap, starting at the given index.
+    void set_palette_bitmap_colors(uint16_t id, uint32_t index, const uint8_t* colors, uint32_t num_colors);
+
+    // Copy packed pixels into an existing palette bitmap, starting at the given position.
+    void set_palette_bitmap_pixels(uint16_t id, int32_t x, int32_t y, const uint8_t* data, uint32_t size);
+
     // Set a pixel within an existing bitmap.
     void set_solid_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_t color, int16_t nth);
     void set_masked_bitmap_pixel(uint16_t id, int32_t x, int32_t y, uint8_t color, int16_t nth);
@@ -188,6 +272,68 @@ class DiManager {
     // Set bitmap ID for tile in tile map.
     void set_tile_map_bitmap_id(uint16_t id, uint16_t col, uint16_t row, uint16_t bm_id);
 
+    // Fill a rectangle of tiles with one bitmap ID (0 removes the tiles).
+    void fill_tile_array_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, uint16_t bm_id);
+    void fill_tile_map_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, uint16_t bm_id);
+
+    // Set a rectangle of tiles from 16-bit bitmap IDs (low byte first), in row-major order.
+    void set_tile_array_block(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids);
+    void set_tile_map_block(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids);
+
+    // Copy (mode 0) or move (mode 1) a rectangle of tiles to another position.
+    void copy_tile_array_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows,
+                            int16_t dst_col, int16_t dst_row, uint8_t mode);
+    void copy_tile_map_region(uint16_t id, int16_t col, int16_t row, int16_t columns, int16_t rows,
+                            int16_t dst_col, int16_t dst_row, uint8_t mode);
+
+    // Flip the tile in one cell of a tile map, without changing the tile bitmap.
+    void set_tile_map_tile_flip(uint16_t id, uint16_t col, uint16_t row, uint8_t flip);
+
+    // Set the scroll position of a tile map (the map pixel shown at its upper-left corner).
+    void set_tile_map_scroll_position(uint16_t id, int32_t x, int32_t y);
+    void set_tile_map_line_table(uint16_t id, uint32_t first_line, uint32_t num_lines, const uint8_t* entries);
+
+    // Make a tile map a window onto a larger world of tiles, kept in PSRAM.
+    void set_tile_map_world_size(uint16_t id, uint32_t world_columns, uint32_t world_rows);
+
+    // Set a rectangle of world tiles from 16-bit bitmap IDs (low byte first), in row-major order.
+    void set_tile_map_world_block(uint16_t id, int32_t col, int32_t row, int32_t columns, int32_t rows, const uint8_t* bm_ids);
+
+    // Set the world scroll position of a tile map (the world pixel shown at its upper-left corner).
+    void set_tile_map_world_scroll_position(uint16_t id, int32_t x, int32_t y);
+
+    // Define the vertices of a mesh in a 3D scene, from prescaled 16-bit X, Y, Z values (low byte first).
+    void define_render_mesh_vertices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* coords);
+
+    // Set the vertex indices of a mesh in a 3D scene, from 16-bit values (low byte first).
+    void set_render_mesh_vertex_indices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* indices);
+
+    // Define the texture coordinates of a mesh in a 3D scene, from 16-bit U, V values (low byte first).
+    void define_render_texture_coordinates(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* coords);
+
+    // Set the texture coordinate indices of a mesh in a 3D scene, from 16-bit values (low byte first).
+    void set_render_texture_coordinate_indices(uint16_t id, uint16_t mid, uint16_t n, const uint8_t* indices);
+
+    // Create (or redefine) an object in a 3D scene, using a mesh, and a bitmap as its texture.
+    void create_render_object(uint16_t id, uint16_t oid, uint16_t mid, uint16_t bmid);
+
+    // Set the prescaled scale factors, rotation angles, or translation distances of an object
+    // in a 3D scene. Only the values selected by the mask (1=X, 2=Y, 4=Z) are changed.
+    void set_render_object_scale(uint16_t id, uint16_t oid, uint8_t mask,
+                            uint16_t scalex, uint16_t scaley, uint16_t scalez);
+    void set_render_object_rotation(uint16_t id, uint16_t oid, uint8_t mask,
+                            int16_t anglex, int16_t angley, int16_t anglez);
+    void set_render_object_translation(uint16_t id, uint16_t oid, uint8_t mask,
+                            int16_t distx, int16_t disty, int16_t distz);
+
+    // Request that a 3D scene be rendered onto the bitmap of its render primitive,
+    // during a later vertical blanking period.
+    void render_to_bitmap(uint16_t id);
+
+    // Animate a tile in a tile map, using a list of 16-bit bitmap IDs (low byte first).
+    void set_tile_map_tile_animation(uint16_t id, uint16_t bm_id, uint32_t frames_per_step,
+                            const uint8_t* frame_ids, uint32_t num_frames);
+
     // Setup a callback for when the visible frame pixels have been sent to DMA,
     // and the vertical blanking time begins.
     void set_on_vertical_blank_cb(DiVoidCallback callback_fcn);
@@ -209,6 +355,18 @@ class DiManager {
     // Get a safe primitive pointer.
     inline DiPrimitive* get_safe_primitive(int16_t id) { return validate_id(id) ? m_primitives[id] : NULL; }
 
+    // Get a safe bitmap pointer, or NULL if the primitive is not a bitmap.
+    inline DiBitmap* get_safe_bitmap(int16_t id) {
+      auto prim = get_safe_primitive(id); return prim ? prim->as_bitmap() : NULL; }
+
+    // Get a safe palette bitmap pointer, or NULL if the primitive is not a palette bitmap.
+    inline DiPaletteBitmap* get_safe_palette_bitmap(int16_t id) {
+      auto prim = get_safe_primitive(id); return prim ? prim->as_palette_bitmap() : NULL; }
+
+    // Get a safe 3D render pointer, or NULL if the primitive is not a render.
+    inline DiRender* get_safe_render(int16_t id) {
+      auto prim = get_safe_primitive(id); return prim ? prim->as_render() : NULL; }
+
     protected:
     // Structures used to support DMA for video.
     volatile lldesc_t *         m_dma_descriptor; // [DMA_TOTAL_DESCR]
@@ -224,10 +382,24 @@ class DiManager {
     DiTerminal*                 m_terminal;
     DiSolidRectangle*           m_cursor;
     uint8_t                     m_flash_count;
+    uint8_t                     m_bitmap_memory; // Memory type for pixels of new bitmaps
     uint8_t                     m_incoming_data[INCOMING_DATA_BUFFER_SIZE];
     std::vector<uint8_t>        m_incoming_command;
     DiPrimitive *               m_primitives[MAX_NUM_PRIMITIVES]; // Indexes of array are primitive IDs
     std::vector<DiPrimitive*>   m_groups[ACT_LINES]; // Vertical scan groups (for optimizing paint calls)
+    std::vector<DiPrimitive*>   m_paint_lists[ACT_LINES]; // Scan groups without primitives hidden by opaque ones
+    std::vector<DiPrimitive*>   m_auto_moved; // Primitives moved automatically in the current frame
+    std::vector<DiSubtreeMember> m_subtree; // Primitives affected by the current recomputation
+    std::vector<DiBitmap*>      m_animated_bitmaps; // Bitmaps that change frames automatically
+    std::vector<DiTileMap*>     m_animated_tile_maps; // Tile maps with tiles that change automatically
+    std::vector<DiTileMap*>     m_world_tile_maps; // Tile maps that are windows onto larger worlds
+    std::vector<DiBitmap*>      m_psram_bitmaps; // Bitmaps whose pixels are cached from PSRAM
+    std::vector<DiCollider>     m_colliders; // Primitives that take part in collision detection
+    std::vector<uint32_t>       m_collisions; // Colliding pairs in the last frame (sorted, ID1 << 16 | ID2)
+    std::vector<uint32_t>       m_new_collisions; // Colliding pairs in the current frame
+    std::vector<DiRasterAction> m_raster_program; // Actions performed per line, sorted by line
+    uint32_t                    m_raster_index; // Index of the next raster action in this frame
+    std::vector<DiRender*>      m_pending_renders; // Renders waiting to draw their 3D scenes
 
     // Setup the DMA stuff.
     void initialize();
@@ -244,12 +416,47 @@ class DiManager {
     // Delete a primitive from the manager.
     void remove_primitive(DiPrimitive* prim);
 
-    // Recompute the geometry and paint list membership for a primitive.
-    void recompute_primitive(DiPrimitive* prim, uint16_t old_flags,
-                             int32_t old_min_group, int32_t old_max_group);
+    // Recompute the geometry and paint list membership for a primitive and its descendants.
+    void recompute_primitive(DiPrimitive* prim);
+
+    // Save information about a primitive and its descendants, before recomputing them.
+    void gather_subtree(DiPrimitive* prim);
+
+    // Rebuild the paint lists for a range of scan groups, leaving out any primitive
+    // that is completely hidden, on a given line, by opaque primitives painted after it.
+    void cull_groups(int32_t min_group, int32_t max_group);
+
     // Finish creating a primitive.
     DiPrimitive* finish_create(uint16_t id, uint16_t flags, DiPrimitive* prim, DiPrimitive* parent_prim);
 
+    // Move all primitives that have pending automatic moves, then adjust their paint groups.
+    void run_auto_motion();
+
+    // Advance the frames of all automatically animated bitmaps and tiles.
+    void run_bitmap_animation();
+
+    // Load the world tiles that have come into view into the windows of all world tile maps.
+    void refill_tile_map_windows();
+
+    // Draw the 3D scene of the oldest pending render, if any.
+    void run_pending_render();
+
+    // Forget the cached lines of all PSRAM bitmaps, and prefetch the first lines of the next frame.
+    void IRAM_ATTR start_bitmap_caches();
+
+    // Prefetch the lines of all PSRAM bitmaps, for screen lines up to (not including) the given line.
+    void IRAM_ATTR prefetch_bitmap_lines(int32_t end_line_index);
+
+    // Detect collisions between primitives, and report the pairs that started or
+    // stopped colliding since the last frame to the EZ80.
+    void run_collision_detection();
+
+    // Determine whether two primitives have any drawn pixels in common.
+    bool check_collision(DiPrimitive* prim1, DiPrimitive* prim2);
+
+    // Perform the raster actions for the given line (and for any lines skipped before it).
+    void IRAM_ATTR run_raster_program(uint32_t line_index);
+
     // Draw all primitives that belong to the active scan line group.
     void IRAM_ATTR draw_primitives(volatile uint32_t* p_scan_line, uint32_t line_index);
 
@@ -302,4 +509,5 @@ class DiManager {
   void send_screen_pixel(int16_t x, int16_t y);
   void send_mode_information();
   void send_general_poll(uint8_t b);
+  void send_collisions(const uint16_t* ids, uint32_t num_pairs);
 };
\ No newline at end of file
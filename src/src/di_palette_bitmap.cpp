@@ -0,0 +1,162 @@
+// di_palette_bitmap.cpp - Function definitions for drawing palette bitmaps
+//
+// A palette bitmap stores 2 or 4 bits per pixel, rather than a whole byte,
+// and each pixel value selects one of the colors in a small palette. Changing
+// the palette recolors the bitmap without sending its pixels again.
+//
+// Copyright (c) 2023 Curtis Whitley
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// 
+
+#include "di_palette_bitmap.h"
+#include <cstring>
+
+DiPaletteBitmap::DiPaletteBitmap(uint32_t width, uint32_t height, uint16_t flags, uint8_t bits_per_pixel) {
+  m_width = width;
+  m_height = height;
+  m_flags = flags;
+  m_bits_per_pixel = bits_per_pixel;
+  m_bytes_per_line = (width * bits_per_pixel + 7) / 8;
+  m_pixels = new uint8_t[m_bytes_per_line * height];
+  memset(m_pixels, 0, m_bytes_per_line * height);
+  memset(m_palette, 0, sizeof(m_palette));
+  m_lut = new uint32_t[256];
+  m_mask_lut = (flags & PRIM_FLAGS_MASKED) ? new uint32_t[256] : NULL;
+  build_lookup_tables();
+}
+
+DiPaletteBitmap::~DiPaletteBitmap() {
+  delete [] m_pixels;
+  delete [] m_lut;
+  delete [] m_mask_lut;
+}
+
+DiPaletteBitmap* DiPaletteBitmap::as_palette_bitmap() {
+  return this;
+}
+
+void DiPaletteBitmap::set_palette_colors(uint32_t index, const uint8_t* colors, uint32_t num_colors) {
+  uint32_t palette_size = (uint32_t)1 << m_bits_per_pixel;
+  while (num_colors-- && index < palette_size) {
+    // Invert the meaning of the alpha bits, for a fully opaque color.
+    m_palette[index++] = PIXEL_ALPHA_INV_MASK(*colors++ | 0xC0);
+  }
+  build_lookup_tables();
+}
+
+void DiPaletteBitmap::build_lookup_tables() {
+  // With 2 bits per pixel, one byte holds 4 pixels, which fill a whole word.
+  // With 4 bits per pixel, one byte holds 2 pixels, which fill the first half of
+  // a word (bytes 2 and 3); shifting the entry right by 16 bits gives the second half.
+  uint32_t pixels_per_byte = 8 / m_bits_per_pixel;
+  uint32_t index_mask = (1 << m_bits_per_pixel) - 1;
+  for (uint32_t packed = 0; packed < 256; packed++) {
+    uint32_t pixels = 0;
+    uint32_t mask = 0;
+    for (uint32_t pos = 0; pos < pixels_per_byte; pos++) {
+      uint32_t index = (packed >> (8 - (pos + 1) * m_bits_per_pixel)) & index_mask;
+      uint32_t shift = FIX_INDEX(pos) * 8;
+      if (index || !m_mask_lut) {
+        pixels |= ((uint32_t)m_palette[index]) << shift;
+        mask |= ((uint32_t)0xFF) << shift;
+      }
+    }
+    m_lut[packed] = pixels;
+    if (m_mask_lut) {
+      m_mask_lut[packed] = mask;
+    }
+  }
+}
+
+void DiPaletteBitmap::set_packed_pixels(int32_t x, int32_t y, const uint8_t* data, uint32_t size) {
+  if (x < 0 || y < 0 || x >= m_width || y >= m_height) {
+    return;
+  }
+  uint32_t offset = y * m_bytes_per_line + (x * m_bits_per_pixel) / 8;
+  uint32_t total = m_bytes_per_line * m_height;
+  if (size > total - offset) {
+    size = total - offset;
+  }
+  memcpy(m_pixels + offset, data, size);
+}
+
+void IRAM_ATTR DiPaletteBitmap::paint(volatile uint32_t* p_scan_line, uint32_t line_index) {
+  auto src_line = m_pixels + ((int32_t)line_index - m_abs_y) * m_bytes_per_line;
+  auto line_bytes = (uint8_t*)p_scan_line;
+  int32_t x = m_draw_x;
+  int32_t x_extent = m_draw_x_extent;
+  uint32_t src_x = x - m_abs_x;
+
+  // Draw single pixels up to a word boundary on the screen.
+  while ((x & 3) && x < x_extent) {
+    auto index = get_index(src_line, src_x++);
+    if (index || !m_mask_lut) {
+      line_bytes[FIX_INDEX(x)] = m_palette[index];
+    }
+    x++;
+  }
+
+  // Draw whole words, expanding the packed pixels through the lookup tables,
+  // when the source pixels also start on a word boundary.
+  if (!(src_x & 3)) {
+    auto dst = (uint32_t*)(line_bytes + x);
+    uint32_t num_words = (x_extent - x) >> 2;
+    auto lut = m_lut;
+    auto mask_lut = m_mask_lut;
+    if (m_bits_per_pixel == 2) {
+      auto src = src_line + (src_x >> 2);
+      if (mask_lut) {
+        for (uint32_t i = 0; i < num_words; i++) {
+          auto packed = src[i];
+          dst[i] = (dst[i] & ~mask_lut[packed]) | lut[packed];
+        }
+      } else {
+        for (uint32_t i = 0; i < num_words; i++) {
+          dst[i] = lut[src[i]];
+        }
+      }
+    } else {
+      auto src = src_line + (src_x >> 1);
+      if (mask_lut) {
+        for (uint32_t i = 0; i < num_words; i++) {
+          auto packed0 = src[i * 2];
+          auto packed1 = src[i * 2 + 1];
+          uint32_t mask = mask_lut[packed0] | (mask_lut[packed1] >> 16);
+          dst[i] = (dst[i] & ~mask) | lut[packed0] | (lut[packed1] >> 16);
+        }
+      } else {
+        for (uint32_t i = 0; i < num_words; i++) {
+          dst[i] = lut[src[i * 2]] | (lut[src[i * 2 + 1]] >> 16);
+        }
+      }
+    }
+    x += num_words << 2;
+    src_x += num_words << 2;
+  }
+
+  // Draw any remaining single pixels.
+  while (x < x_extent) {
+    auto index = get_index(src_line, src_x++);
+    if (index || !m_mask_lut) {
+      line_bytes[FIX_INDEX(x)] = m_palette[index];
+    }
+    x++;
+  }
+}
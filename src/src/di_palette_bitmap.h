@@ -0,0 +1,73 @@
+// di_palette_bitmap.h - Function declarations for drawing palette bitmaps
+//
+// A palette bitmap stores 2 or 4 bits per pixel, rather than a whole byte,
+// and each pixel value selects one of the colors in a small palette. Changing
+// the palette recolors the bitmap without sending its pixels again.
+//
+// Copyright (c) 2023 Curtis Whitley
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+// 
+
+#pragma once
+#include "di_primitive.h"
+
+class DiPaletteBitmap : public DiPrimitive {
+  public:
+  // Construct a palette bitmap, using 2 or 4 bits per pixel. All pixels start as value 0.
+  // With PRIM_FLAGS_MASKED, pixel value 0 is transparent, rather than using palette color 0.
+  DiPaletteBitmap(uint32_t width, uint32_t height, uint16_t flags, uint8_t bits_per_pixel);
+
+  // Destroy a palette bitmap.
+  ~DiPaletteBitmap();
+
+  // Set colors in the palette, starting at the given index. The alpha bits of the colors are
+  // ignored (the colors are fully opaque). Colors beyond the size of the palette are ignored.
+  void set_palette_colors(uint32_t index, const uint8_t* colors, uint32_t num_colors);
+
+  // Copy packed pixel data into the bitmap, starting at the given position, and continuing
+  // in row-major order. The first pixel of each byte is in its most significant bits.
+  // The X position is rounded down to the start of a byte.
+  void set_packed_pixels(int32_t x, int32_t y, const uint8_t* data, uint32_t size);
+
+  virtual void IRAM_ATTR paint(volatile uint32_t* p_scan_line, uint32_t line_index);
+
+  // Get this primitive as a palette bitmap.
+  virtual DiPaletteBitmap* as_palette_bitmap();
+
+  protected:
+  // Rebuild the tables that expand one byte of packed pixels into pixel bytes.
+  void build_lookup_tables();
+
+  // Get the palette index of a single pixel.
+  inline uint32_t get_index(const uint8_t* src_line, uint32_t x) {
+    if (m_bits_per_pixel == 2) {
+      return (src_line[x >> 2] >> (6 - ((x & 3) << 1))) & 0x03;
+    } else {
+      return (src_line[x >> 1] >> ((x & 1) ? 0 : 4)) & 0x0F;
+    }
+  }
+
+  uint32_t    m_bytes_per_line;   // number of bytes of packed pixels in each line
+  uint8_t*    m_pixels;           // packed pixels
+  uint32_t*   m_lut;              // pixel bytes for each byte of packed pixels (in FIX_INDEX order)
+  uint32_t*   m_mask_lut;         // 0xFF for each drawn pixel byte (NULL if not masked)
+  uint8_t     m_palette[16];      // adjusted colors, indexed by pixel value
+  uint8_t     m_bits_per_pixel;   // 2 or 4
+};
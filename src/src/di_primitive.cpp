@@ -30,6 +30,8 @@ DiPrimitive::DiPrimitive() {
   // Zero out everything but the vtable pointer.
   memset(((uint8_t*)this)+sizeof(DiPrimitive*), 0, sizeof(DiPrimitive)-sizeof(DiPrimitive*));
   m_flags = PRIM_FLAGS_DEFAULT;
+  m_first_group = -1;
+  m_last_group = -1;
 }
 
 DiPrimitive::~DiPrimitive() {
@@ -96,12 +98,34 @@ void IRAM_ATTR DiPrimitive::detach_child(DiPrimitive* child) {
 void IRAM_ATTR DiPrimitive::set_relative_position(int32_t rel_x, int32_t rel_y) {
   m_rel_x = rel_x;
   m_rel_y = rel_y;
+  m_auto_frac = 0; // a fraction from earlier auto motion does not apply to the new position
 }
 
 void IRAM_ATTR DiPrimitive::set_relative_deltas(int32_t rel_dx, int32_t rel_dy, uint32_t auto_moves) {
   m_rel_dx = rel_dx;
   m_rel_dy = rel_dy;
   m_auto_moves = auto_moves;
+  m_auto_frac = 0;
+}
+
+bool IRAM_ATTR DiPrimitive::apply_auto_move() {
+  if (!m_auto_moves) {
+    return false;
+  } else if (m_auto_moves > 0) {
+    m_auto_moves--; // a negative count means to move indefinitely
+  }
+
+  // Form 64-bit 16.16 positions from the whole and fractional parts, then add the deltas,
+  // so that the whole parts keep all 32 bits.
+  int64_t x = ((int64_t)m_rel_x << 16) + (int64_t)(m_auto_frac & 0xFFFF) + m_rel_dx;
+  int64_t y = ((int64_t)m_rel_y << 16) + (int64_t)(m_auto_frac >> 16) + m_rel_dy;
+  m_auto_frac = (((uint32_t)y & 0xFFFF) << 16) | ((uint32_t)x & 0xFFFF);
+
+  auto old_x = m_rel_x;
+  auto old_y = m_rel_y;
+  m_rel_x = (int32_t)(x >> 16);
+  m_rel_y = (int32_t)(y >> 16);
+  return (m_rel_x != old_x || m_rel_y != old_y);
 }
 
 void IRAM_ATTR DiPrimitive::set_size(uint32_t width, uint32_t height) {
@@ -168,6 +192,34 @@ void DiPrimitive::clear_child_ptrs() {
   m_last_child = NULL;
 }
 
+bool DiPrimitive::get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  return false;
+}
+
+bool DiPrimitive::find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  if (line_index < m_draw_y || line_index >= m_draw_y_extent) {
+    return false;
+  }
+  x = MAX(x, m_draw_x);
+  x_extent = MIN(x_extent, m_draw_x_extent);
+  return (x < x_extent);
+}
+
+void IRAM_ATTR DiPrimitive::set_visible_line(uint32_t start_line) {
+}
+
+DiBitmap* DiPrimitive::as_bitmap() {
+  return NULL;
+}
+
+DiRender* DiPrimitive::as_render() {
+  return NULL;
+}
+
+DiPaletteBitmap* DiPrimitive::as_palette_bitmap() {
+  return NULL;
+}
+
 void IRAM_ATTR DiPrimitive::delete_instructions() {
 }
 
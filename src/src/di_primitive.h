@@ -31,6 +31,20 @@
 #include "di_constants.h"
 #include "di_code.h"
 
+// Blend a source pixel (with inverted alpha bits) over a destination pixel, as the
+// generated code does for 4 pixels at a time. The result is a fully opaque color.
+static inline uint8_t blend_pixel(uint8_t dst, uint8_t src) {
+  uint32_t src_part = 4 - (src >> 6); // source opaqueness, in quarters
+  uint32_t dst_part = 4 - src_part;
+  uint32_t br = (((src & 0x33) * src_part + (dst & 0x33) * dst_part) >> 2) & 0x33;
+  uint32_t g = (((src & 0x0C) * src_part + (dst & 0x0C) * dst_part) >> 2) & 0x0C;
+  return (uint8_t)(br | g);
+}
+
+class DiBitmap;
+class DiRender;
+class DiPaletteBitmap;
+
 #pragma pack(push,1)
 
 class DiPrimitive {
@@ -67,6 +81,10 @@ class DiPrimitive {
   // These values are used to update the relative position automatically, frame-by-frame.
   void IRAM_ATTR set_relative_deltas(int32_t rel_dx, int32_t rel_dy, uint32_t auto_moves);
 
+  // Apply one automatic move, if any are pending, by adding the 16.16 deltas to
+  // the relative position. Returns true if the whole-pixel position changed.
+  bool IRAM_ATTR apply_auto_move();
+
   // Set the size of the primitive. This only used for certain types of primitives.
   virtual void IRAM_ATTR set_size(uint32_t width, uint32_t height);
 
@@ -75,6 +93,36 @@ class DiPrimitive {
   // this primitive is based on the given viewport parameters and certain flags.
   void IRAM_ATTR compute_absolute_geometry(int32_t view_x, int32_t view_y, int32_t view_x_extent, int32_t view_y_extent);
 
+  // Get the horizontal span of pixels that painting may write on any line,
+  // widened to whole words, because some drawing writes entire words.
+  inline void get_paint_span(int32_t& x, int32_t& x_extent) {
+    x = m_draw_x & 0xFFFFFFFC;
+    x_extent = (m_draw_x_extent + 3) & 0xFFFFFFFC;
+  }
+
+  // Get the horizontal span of pixels that are always painted fully opaque on the given
+  // line, hiding anything painted beneath them. Returns false if there is no such span.
+  virtual bool get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent);
+
+  // Find the first run of drawn pixels on the given line, within the span from x up to
+  // (but not including) x_extent, in screen coordinates. If one is found, x and x_extent
+  // are narrowed to that run, and the function returns true. This is used for collision
+  // detection; the default treats the entire draw region as being drawn.
+  virtual bool find_drawn_run(int32_t line_index, int32_t& x, int32_t& x_extent);
+
+  // Show the pixels starting at the given line of the primitive's image. Only bitmaps
+  // have such lines; other primitives ignore this.
+  virtual void IRAM_ATTR set_visible_line(uint32_t start_line);
+
+  // Get this primitive as a bitmap, or NULL if it is not a bitmap.
+  virtual DiBitmap* as_bitmap();
+
+  // Get this primitive as a 3D render, or NULL if it is not a render.
+  virtual DiRender* as_render();
+
+  // Get this primitive as a palette bitmap, or NULL if it is not a palette bitmap.
+  virtual DiPaletteBitmap* as_palette_bitmap();
+
   // Clear the custom instructions needed to draw the primitive.
   virtual void IRAM_ATTR delete_instructions();
    
@@ -111,12 +159,21 @@ class DiPrimitive {
   inline DiPrimitive* get_next_sibling() { return m_next_sibling; }
   inline uint8_t get_color() { return (uint8_t)m_color; }
   inline uint32_t get_color32() { return m_color; }
+  inline int32_t get_auto_moves() { return m_auto_moves; }
+  inline int32_t get_first_group() { return m_first_group; }
+  inline int32_t get_last_group() { return m_last_group; }
+  inline bool is_raster_hidden() { return m_raster_hidden; }
+  inline bool is_raster_target() { return m_raster_target; }
 
   // Sets some data members.
   inline void set_flags(uint16_t flags) { m_flags = flags; }
   inline void add_flags(uint16_t flags) { m_flags |= flags; }
   inline void remove_flags(uint16_t flags) { m_flags &= ~flags; }
+  inline void set_groups(int32_t first, int32_t last) {
+    m_first_group = (int16_t)first; m_last_group = (int16_t)last; }
   inline void set_color32(uint32_t color) { m_color = color; }
+  inline void set_raster_hidden(bool hidden) { m_raster_hidden = hidden; }
+  inline void set_raster_target(bool target) { m_raster_target = target; }
 
   // Clear the pointers to children.
   void clear_child_ptrs();
@@ -127,10 +184,6 @@ class DiPrimitive {
     return (uint8_t*)line;
   }
 
-  // Recompute the geometry and paint list membership of a primitive.
-  void recompute_primitive(DiPrimitive* prim, uint16_t old_flags,
-                            int32_t old_min_group, int32_t old_max_group);
-
   // Allocate a set of dynamic functions.
   void allocate_functions(uint32_t width);
 
@@ -168,7 +221,7 @@ class DiPrimitive {
   int32_t   m_draw_x_word;  // m_draw_x & 0xFFFFFFFC (word boundary)
   int32_t   m_draw_x_word_offset; // difference of m_draw_x_word - m_abs_x_word
   uint32_t  m_color;        // applies to some primitives, but not to others
-  uint32_t  m_future32;     // for potential future use
+  uint32_t  m_auto_frac;    // auto-motion fractions (x in low 16 bits, y in high 16 bits)
   DiPrimitive* m_parent;       // id of parent primitive
   DiPrimitive* m_first_child;  // id of first child primitive
   DiPrimitive* m_last_child;   // id of last child primitive
@@ -178,6 +231,8 @@ class DiPrimitive {
   int16_t   m_last_group;   // highest index of drawing group in which it is a member
   int16_t   m_id;           // id of this primitive
   uint16_t  m_flags;        // flag bits to control painting, etc.
+  bool      m_raster_hidden; // whether a raster program hides this primitive on the current line
+  bool      m_raster_target; // whether the raster program has actions for this primitive
 };
 
 #pragma pack(pop)
\ No newline at end of file
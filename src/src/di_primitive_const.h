@@ -52,7 +52,7 @@
 #define FLD_draw_x_word  92      // m_draw_x & 0xFFFFFFFC (word boundary)
 #define FLD_draw_x_word_offset  96 // difference of m_draw_x_word - m_abs_x_word
 #define FLD_color  100           // applies to some primitives, but not to others
-#define FLD_future32  104        // for potential future use
+#define FLD_auto_frac  104       // auto-motion fractions (x in low 16 bits, y in high 16 bits)
 #define FLD_parent  108          // id of parent primitive
 #define FLD_first_child  112     // id of first child primitive
 #define FLD_last_child  116      // id of last child primitive
@@ -63,4 +63,6 @@
 #define FLD_last_group  130      // highest index of drawing group in which it is a member
 #define FLD_id  132              // id of this primitive
 #define FLD_flags  134           // flag bits to control painting, etc.
-#define sizeof_DiPrimitive  136  // total size of the base class structure
+#define FLD_raster_hidden  136   // whether a raster program hides this primitive on the current line
+#define FLD_raster_target  137   // whether the raster program has actions for this primitive
+#define sizeof_DiPrimitive  138  // total size of the base class structure
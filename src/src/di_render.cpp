@@ -24,163 +24,353 @@
 // README.md and LICENSE in the pingo directory for more information.
 //
 
+
 #include "di_render.h"
 #include "esp_heap_caps.h"
+#include <cstring>
 
 extern "C" {
-
-#include "pingo/assets/teapot.h"
-
-#include "pingo/render/mesh.h"
-#include "pingo/render/object.h"
-#include "pingo/render/pixel.h"
-#include "pingo/render/renderer.h"
 #include "pingo/render/scene.h"
-#include "pingo/render/backend.h"
-#include "pingo/render/depth.h"
-#include <cstring>
-
-typedef struct Pixel Pixel;
-
-typedef  struct {
-    BackEnd backend;
-    Vec2i size;
-} DiRenderBackEnd;
-
-void di_render_init(DiRenderBackEnd * backend, Vec2i size);
-
-DiRenderBackEnd my_backend;
-Vec4i rect;
-Vec2i totalSize;
-PingoDepth * zetaBuffer;
-Pixel * frameBuffer;
-PingoDepth * my_zetaBuffer;
-
-
-void init( Renderer * ren, BackEnd * backEnd, Vec4i _rect) {
-    rect = _rect;
+#include "pingo/render/texture.h"
 
+static void di_init(Renderer* ren, BackEnd* backEnd, Vec4i rect) {
 }
 
-void beforeRender( Renderer * ren, BackEnd * backEnd) {
-    //DiRenderBackEnd * backend = (DiRenderBackEnd *) backEnd;
+static void di_before_render(Renderer* ren, BackEnd* backEnd) {
 }
 
-void afterRender( Renderer * ren,  BackEnd * backEnd) {
+static void di_after_render(Renderer* ren, BackEnd* backEnd) {
 }
 
-Pixel * getFrameBuffer( Renderer * ren,  BackEnd * backEnd) {
-    return frameBuffer;
+static Pixel* di_get_frame_buffer(Renderer* ren, BackEnd* backEnd) {
+  return ((DiRenderBackEnd*)backEnd)->m_frame_buffer;
 }
 
-PingoDepth * getZetaBuffer( Renderer * ren,  BackEnd * backEnd) {
-    return my_zetaBuffer;
+static PingoDepth* di_get_zeta_buffer(Renderer* ren, BackEnd* backEnd) {
+  return ((DiRenderBackEnd*)backEnd)->m_depth_buffer;
 }
 
-void di_render_init( DiRenderBackEnd * backend, Vec2i size) {
-  frameBuffer = (Pixel*) heap_caps_malloc(sizeof(Pixel) * 160 * 120, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
-  my_zetaBuffer = (PingoDepth*) heap_caps_malloc(sizeof(PingoDepth) * 160 * 120, MALLOC_CAP_8BIT | MALLOC_CAP_SPIRAM);
+} // extern "C"
 
-  totalSize = size;
-  backend->backend.init = &init;
-  backend->backend.beforeRender = &beforeRender;
-  backend->backend.afterRender = &afterRender;
-  backend->backend.getFrameBuffer = &getFrameBuffer;
-  backend->backend.getZetaBuffer = &getZetaBuffer;
-  backend->backend.drawPixel = 0;
+// Allocate memory for render data, preferring PSRAM, and falling back to internal RAM.
+static void* alloc_render_memory(uint32_t bytes) {
+  auto p = heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+  if (!p) {
+    p = heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+  }
+  return p;
 }
 
-} // extern "C"
+// Get a 16-bit value (low byte first) from command data.
+static inline uint16_t get_u16(const uint8_t* data) {
+  return (uint16_t)data[0] | ((uint16_t)data[1] << 8);
+}
 
 //-----------------------------------------
 
 DiRender::DiRender(uint32_t width, uint32_t height, uint16_t flags) :
-  DiBitmap(width, height, flags) {
+  DiBitmap(width, height, flags, BITMAP_MEMORY_INTERNAL) {
+  m_backend.m_backend.init = &di_init;
+  m_backend.m_backend.beforeRender = &di_before_render;
+  m_backend.m_backend.afterRender = &di_after_render;
+  m_backend.m_backend.getFrameBuffer = &di_get_frame_buffer;
+  m_backend.m_backend.getZetaBuffer = &di_get_zeta_buffer;
+  m_backend.m_backend.drawPixel = 0;
+  m_backend.m_frame_buffer = (Pixel*) alloc_render_memory(sizeof(Pixel) * width * height);
+  m_backend.m_depth_buffer = (PingoDepth*) alloc_render_memory(sizeof(PingoDepth) * width * height);
+  m_vertex_cache = NULL;
+  m_vertex_cache_size = 0;
 }
 
 DiRender::~DiRender() {
+  for (auto object = m_objects.begin(); object != m_objects.end(); ++object) {
+    heap_caps_free(object->second->m_tex_pixels);
+    delete object->second;
+  }
+  for (auto mesh = m_meshes.begin(); mesh != m_meshes.end(); ++mesh) {
+    delete mesh->second;
+  }
+  heap_caps_free(m_backend.m_frame_buffer);
+  heap_caps_free(m_backend.m_depth_buffer);
+  heap_caps_free(m_vertex_cache);
 }
 
-extern "C" {
-
-float angleZ = 3.142128;
+DiRender* DiRender::as_render() {
+  return this;
+}
 
-void do_render(int width, int height) {
-  Vec2i size = {width, height};
+DiRenderMesh* DiRender::get_mesh(uint16_t mid) {
+  auto mesh_item = m_meshes.find(mid);
+  if (mesh_item != m_meshes.end()) {
+    return mesh_item->second;
+  }
+  auto mesh = new DiRenderMesh;
+  mesh->m_version = 1;
+  mesh->m_normals_version = 0; // matches no mesh
+  m_meshes[mid] = mesh;
+  return mesh;
+}
 
-  di_render_init(&my_backend, size);
-  Renderer renderer;
-  rendererInit(&renderer, size,(BackEnd*) &my_backend );
-  rendererSetCamera(&renderer,(Vec4i){0,0,size.x,size.y});
-
-  Scene s;
-  sceneInit(&s);
-  rendererSetScene(&renderer, &s);
-
-  Object object;
-  //object.material = NULL;
-  object.mesh = &mesh_teapot;
-
-/*
-  Material m;
-  Texture tex;
-  tex.size = Vec2i{2,2};
-  Pixel solid[4];
-  solid[0] = Pixel { 0xFE, 0xFD, 0x00, 0xFF };
-  solid[1] = Pixel { 0xEE, 0x00, 0xEC, 0xFF };
-  solid[2] = Pixel { 0x00, 0xDD, 0xDC, 0xFF };
-  solid[3] = Pixel { 0xCE, 0x00, 0x00, 0xFF };
-  tex.frameBuffer = solid;
-  m.texture = &tex;
-  object.material = &m;
-*/
-  object.material = NULL;
-
-  sceneAddRenderable(&s, object_as_renderable(&object));
-
-  float phi = 0;
-  Mat4 t;
+DiRenderObject* DiRender::get_object(uint16_t oid) {
+  auto object_item = m_objects.find(oid);
+  if (object_item != m_objects.end()) {
+    return object_item->second;
+  }
+  return NULL;
+}
 
-  // PROJECTION MATRIX - Defines the type of projection used
-  renderer.camera_projection = mat4Perspective( 1, 2500.0,(float)size.x / (float)size.y, 0.6);
+void DiRender::define_mesh_vertices(uint16_t mid, uint32_t num_vertices, const uint8_t* coords) {
+  auto mesh = get_mesh(mid);
+  mesh->m_positions.resize(num_vertices);
+  for (uint32_t i = 0; i < num_vertices; i++) {
+    auto position = &mesh->m_positions[i];
+    position->x = (float)(int16_t)get_u16(coords) / 32767.0f;
+    position->y = (float)(int16_t)get_u16(coords + 2) / 32767.0f;
+    position->z = (float)(int16_t)get_u16(coords + 4) / 32767.0f;
+    coords += 6;
+  }
+  mesh->m_version++;
+}
 
-  //VIEW MATRIX - Defines position and orientation of the "camera"
-  Mat4 v = mat4Translate((Vec3f) { 0,2,-35});
+void DiRender::set_mesh_vertex_indices(uint16_t mid, uint32_t num_indices, const uint8_t* indices) {
+  auto mesh = get_mesh(mid);
+  mesh->m_pos_indices.resize(num_indices);
+  for (uint32_t i = 0; i < num_indices; i++) {
+    mesh->m_pos_indices[i] = get_u16(indices);
+    indices += 2;
+  }
+  mesh->m_version++;
+}
 
-  Mat4 rotateDown = mat4RotateX(-0.40); //Rotate around origin/orbit
-  renderer.camera_view = mat4MultiplyM(&rotateDown, &v );
+void DiRender::define_texture_coordinates(uint16_t mid, uint32_t num_coords, const uint8_t* coords) {
+  auto mesh = get_mesh(mid);
+  mesh->m_tex_coords.resize(num_coords);
+  for (uint32_t i = 0; i < num_coords; i++) {
+    auto tex_coord = &mesh->m_tex_coords[i];
+    tex_coord->x = (float)get_u16(coords);
+    tex_coord->y = (float)get_u16(coords + 2);
+    coords += 4;
+  }
+  mesh->m_version++;
+}
 
-  object.transform = mat4Scale(Vec3f { 6.0f, 6.0f, 6.0f });
-  
-  //TRANSFORM - Defines position and orientation of the object
-  t = mat4RotateZ(angleZ);
-  angleZ += 3.142128f/4.0f;
+void DiRender::set_texture_coordinate_indices(uint16_t mid, uint32_t num_indices, const uint8_t* indices) {
+  auto mesh = get_mesh(mid);
+  mesh->m_tex_indices.resize(num_indices);
+  for (uint32_t i = 0; i < num_indices; i++) {
+    mesh->m_tex_indices[i] = get_u16(indices);
+    indices += 2;
+  }
+  mesh->m_version++;
+}
 
-  object.transform = mat4MultiplyM(&object.transform, &t );  
+void DiRender::create_object(uint16_t oid, uint16_t mid, DiBitmap* texture) {
+  auto object = get_object(oid);
+  if (object) {
+    heap_caps_free(object->m_tex_pixels);
+  } else {
+    object = new DiRenderObject;
+    m_objects[oid] = object;
+  }
+  object->m_mid = mid;
+  object->m_mesh_version = 0; // matches no mesh
+  object->m_tex_pixels = NULL;
+  object->m_scale = (Vec3f) { 1.0f, 1.0f, 1.0f };
+  object->m_rotation = (Vec3f) { 0.0f, 0.0f, 0.0f };
+  object->m_translation = (Vec3f) { 0.0f, 0.0f, 0.0f };
+  object->m_transform_valid = false;
+  object->m_object.mesh = &object->m_mesh;
+  object->m_object.material = NULL;
+  object->m_mesh.indexes_count = 0;
+  object->m_mesh.positions_count = 0;
+  object->m_mesh.face_normals = NULL;
+  object->m_material.texture = &object->m_texture;
+
+  if (texture) {
+    // The texture is converted once, here, rather than on every render.
+    int32_t width = texture->get_width();
+    int32_t height = texture->get_height();
+    auto tex_pixels = (width && height) ? (Pixel*) alloc_render_memory(sizeof(Pixel) * width * height) : NULL;
+    if (tex_pixels) {
+      auto pixel = tex_pixels;
+      for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+          auto color = texture->get_pixel(x, y);
+          pixel->r = (color & 0x03) * 85;
+          pixel->g = ((color >> 2) & 0x03) * 85;
+          pixel->b = ((color >> 4) & 0x03) * 85;
+          pixel->a = 255;
+          pixel++;
+        }
+      }
+      object->m_tex_pixels = tex_pixels;
+      texture_init(&object->m_texture, (Vec2i) { width, height }, tex_pixels);
+    }
+  }
+}
 
-  t = mat4RotateZ(0);
-  object.transform = mat4MultiplyM(&object.transform, &t );
+void DiRender::set_object_scale(uint16_t oid, uint8_t mask, float x, float y, float z) {
+  auto object = get_object(oid);
+  if (object) {
+    if (mask & 1) object->m_scale.x = x;
+    if (mask & 2) object->m_scale.y = y;
+    if (mask & 4) object->m_scale.z = z;
+    object->m_transform_valid = false;
+  }
+}
 
-  //SCENE
-  s.transform = mat4RotateY(phi);
-  phi += 0.01;
+void DiRender::set_object_rotation(uint16_t oid, uint8_t mask, float x, float y, float z) {
+  auto object = get_object(oid);
+  if (object) {
+    if (mask & 1) object->m_rotation.x = x;
+    if (mask & 2) object->m_rotation.y = y;
+    if (mask & 4) object->m_rotation.z = z;
+    object->m_transform_valid = false;
+  }
+}
 
-  rendererRender(&renderer);
+void DiRender::set_object_translation(uint16_t oid, uint8_t mask, float x, float y, float z) {
+  auto object = get_object(oid);
+  if (object) {
+    if (mask & 1) object->m_translation.x = x;
+    if (mask & 2) object->m_translation.y = y;
+    if (mask & 4) object->m_translation.z = z;
+    object->m_transform_valid = false;
+  }
 }
 
-} // extern "C"
+bool DiRender::prepare_object(DiRenderObject* object) {
+  auto mesh_item = m_meshes.find(object->m_mid);
+  if (mesh_item == m_meshes.end()) {
+    return false;
+  }
+  auto mesh = mesh_item->second;
+
+  if (object->m_mesh_version != mesh->m_version) {
+    // The mesh is checked once per change, so that pingo never reads past its data.
+    object->m_mesh_version = mesh->m_version;
+    object->m_object.material = NULL;
+    uint32_t count = (mesh->m_pos_indices.size() / 3) * 3;
+    for (uint32_t i = 0; i < count; i++) {
+      if (mesh->m_pos_indices[i] >= mesh->m_positions.size()) {
+        count = 0;
+      }
+    }
+    object->m_mesh.indexes_count = count;
+    object->m_mesh.positions = mesh->m_positions.data();
+    object->m_mesh.pos_indices = mesh->m_pos_indices.data();
+    object->m_mesh.positions_count = mesh->m_positions.size();
+
+    // The face normals are shared by all objects using the mesh, and do not depend on
+    // their transforms, so they are computed once per change of the mesh.
+    if (count && mesh->m_normals_version != mesh->m_version) {
+      mesh->m_face_normals.resize(count / 3);
+      meshComputeFaceNormals(&object->m_mesh, mesh->m_face_normals.data());
+      mesh->m_normals_version = mesh->m_version;
+    }
+    object->m_mesh.face_normals = count ? mesh->m_face_normals.data() : NULL;
+
+    bool textured = (count && object->m_tex_pixels && mesh->m_tex_indices.size() >= count);
+    for (uint32_t i = 0; textured && i < count; i++) {
+      if (mesh->m_tex_indices[i] >= mesh->m_tex_coords.size()) {
+        textured = false;
+      }
+    }
+    if (textured) {
+      // The texture coordinates are in texture pixels, but pingo uses 0.0 to 1.0.
+      auto num_coords = mesh->m_tex_coords.size();
+      object->m_tex_coords.resize(num_coords);
+      for (uint32_t i = 0; i < num_coords; i++) {
+        object->m_tex_coords[i].x = mesh->m_tex_coords[i].x / object->m_texture.size.x;
+        object->m_tex_coords[i].y = mesh->m_tex_coords[i].y / object->m_texture.size.y;
+      }
+      object->m_mesh.tex_indices = mesh->m_tex_indices.data();
+      object->m_mesh.textCoord = object->m_tex_coords.data();
+      object->m_object.material = &object->m_material;
+    }
+  }
+
+  if (!object->m_transform_valid) {
+    Mat4 t = mat4Scale(object->m_scale);
+    Mat4 r = mat4RotateX(object->m_rotation.x);
+    t = mat4MultiplyM(&t, &r);
+    r = mat4RotateY(object->m_rotation.y);
+    t = mat4MultiplyM(&t, &r);
+    r = mat4RotateZ(object->m_rotation.z);
+    t = mat4MultiplyM(&t, &r);
+    r = mat4Translate(object->m_translation);
+    object->m_object.transform = mat4MultiplyM(&t, &r);
+    object->m_transform_valid = true;
+  }
+  return object->m_mesh.indexes_count > 0;
+}
 
 void DiRender::render() {
-  do_render(m_width, m_height);
+  if (!m_backend.m_frame_buffer || !m_backend.m_depth_buffer) {
+    return;
+  }
+
+  Vec2i size = { m_width, (int32_t)m_save_height };
+  Renderer renderer;
+  rendererInit(&renderer, size, (BackEnd*) &m_backend);
+  rendererSetCamera(&renderer, (Vec4i) { 0, 0, size.x, size.y });
+
+  Scene scene;
+  sceneInit(&scene);
+  rendererSetScene(&renderer, &scene);
+
+  // Only objects whose meshes or transforms changed are recomputed.
+  uint32_t max_positions = 0;
+  for (auto object = m_objects.begin(); object != m_objects.end(); ++object) {
+    if (prepare_object(object->second)) {
+      if (sceneAddRenderable(&scene, object_as_renderable(&object->second->m_object))) {
+        break; // the scene is full
+      }
+      if ((uint32_t)object->second->m_mesh.positions_count > max_positions) {
+        max_positions = object->second->m_mesh.positions_count;
+      }
+    }
+  }
+
+  // The vertex cache only grows. Without it, vertices are transformed once per triangle.
+  if (max_positions > m_vertex_cache_size) {
+    auto cache = (TransformedVertex*) alloc_render_memory(sizeof(TransformedVertex) * max_positions);
+    if (cache) {
+      heap_caps_free(m_vertex_cache);
+      m_vertex_cache = cache;
+      m_vertex_cache_size = max_positions;
+    }
+  }
+  if (m_vertex_cache) {
+    rendererSetVertexCache(&renderer, m_vertex_cache, m_vertex_cache_size);
+  }
+
+  // PROJECTION MATRIX - Defines the type of projection used
+  renderer.camera_projection = mat4Perspective(1, 2500.0, (float)size.x / (float)size.y, 0.6);
+
+  // VIEW MATRIX - Defines position and orientation of the "camera"
+  renderer.camera_view = mat4Translate((Vec3f) { 0, 0, -35 });
+
+  rendererRender(&renderer);
 
-  Pixel* p_render_pixels = frameBuffer;
-	for (int y = 0; y < m_height; y++) {
-		for (int x = 0; x < m_width; x++) {
-			uint8_t c = ((p_render_pixels->b >> 6) << 4) |
+  // Pixels that nothing was drawn on are transparent, if the bitmap may have such pixels.
+  auto transparent_color = m_asset->get_transparent_color();
+  bool masked = (m_flags & (PRIM_FLAGS_MASKED|PRIM_FLAGS_BLENDED)) != 0;
+  Pixel* p_render_pixels = m_backend.m_frame_buffer;
+  for (int32_t y = 0; y < size.y; y++) {
+    auto line_bytes = (uint8_t*)(m_pixels + y * m_words_per_line);
+    for (int32_t x = 0; x < size.x; x++) {
+      uint8_t color;
+      if (masked && !p_render_pixels->a) {
+        color = transparent_color;
+      } else {
+        color = PIXEL_ALPHA_INV_MASK(((p_render_pixels->b >> 6) << 4) |
                   ((p_render_pixels->g >> 6) << 2) |
-                  ((p_render_pixels->r >> 6));
-			set_transparent_pixel(x, y, c|PIXEL_ALPHA_100_MASK);
+                  (p_render_pixels->r >> 6) | PIXEL_ALPHA_100_MASK);
+      }
+      line_bytes[FIX_INDEX(x)] = color;
       p_render_pixels++;
-		}
-	}
+    }
+  }
+  m_asset->set_code_valid(false);
 }
@@ -27,6 +27,52 @@
 #pragma once
 #include "di_bitmap.h"
 #include "di_code.h"
+#include <map>
+#include <vector>
+
+extern "C" {
+#include "pingo/render/mesh.h"
+#include "pingo/render/object.h"
+#include "pingo/render/pixel.h"
+#include "pingo/render/backend.h"
+#include "pingo/render/depth.h"
+#include "pingo/render/renderer.h"
+}
+
+// A mesh, which may be used by many objects. The coordinates are kept as floating point
+// values, converted from the scaled values in the commands.
+typedef struct {
+  std::vector<Vec3f>    m_positions;    // vertex coordinates
+  std::vector<uint16_t> m_pos_indices;  // vertex indexes, 3 per triangle
+  std::vector<Vec2f>    m_tex_coords;   // texture coordinates, in texture pixels
+  std::vector<uint16_t> m_tex_indices;  // texture coordinate indexes, 1 per vertex index
+  std::vector<Vec3f>    m_face_normals; // unit normal of each triangle, for lighting
+  uint32_t              m_version;      // incremented whenever the mesh changes
+  uint32_t              m_normals_version; // version of the mesh that m_face_normals matches
+} DiRenderMesh;
+
+// An object, which is a mesh drawn with a particular texture and transformation.
+typedef struct {
+  Object      m_object;         // pingo object (points to m_mesh and m_material)
+  Mesh        m_mesh;           // pingo mesh (points to the data of the shared mesh)
+  Material    m_material;       // pingo material (points to m_texture)
+  Texture     m_texture;        // pingo texture (points to m_tex_pixels)
+  uint16_t    m_mid;            // ID of the mesh used by the object
+  uint32_t    m_mesh_version;   // version of the mesh that m_mesh matches
+  std::vector<Vec2f> m_tex_coords; // texture coordinates of the mesh, scaled for the texture
+  Pixel*      m_tex_pixels;     // copy of the texture bitmap (NULL if none)
+  Vec3f       m_scale;          // scale factors
+  Vec3f       m_rotation;       // rotation angles, in radians
+  Vec3f       m_translation;    // translation distances
+  bool        m_transform_valid; // whether the object transform matches the values above
+} DiRenderObject;
+
+// The pingo backend of a render, which gives pingo the buffers of the render.
+typedef struct {
+  BackEnd     m_backend;
+  Pixel*      m_frame_buffer;
+  PingoDepth* m_depth_buffer;
+} DiRenderBackEnd;
 
 class DiRender : public DiBitmap {
   public:
@@ -36,8 +82,51 @@ class DiRender : public DiBitmap {
   // Destroy a render.
   ~DiRender();
 
+  // Set the vertices of a mesh, creating the mesh if needed. The coordinates are
+  // 16-bit signed values (low byte first), X, Y, and Z for each vertex.
+  void define_mesh_vertices(uint16_t mid, uint32_t num_vertices, const uint8_t* coords);
+
+  // Set the vertex indexes of a mesh, 3 per triangle, creating the mesh if needed.
+  void set_mesh_vertex_indices(uint16_t mid, uint32_t num_indices, const uint8_t* indices);
+
+  // Set the texture coordinates of a mesh, creating the mesh if needed. The coordinates are
+  // 16-bit values (low byte first), U and V for each pair, in texture pixels.
+  void define_texture_coordinates(uint16_t mid, uint32_t num_coords, const uint8_t* coords);
+
+  // Set the texture coordinate indexes of a mesh, 1 per vertex index, creating the mesh if needed.
+  void set_texture_coordinate_indices(uint16_t mid, uint32_t num_indices, const uint8_t* indices);
+
+  // Create (or redefine) an object that draws a mesh, colored by the pixels of a bitmap.
+  // The bitmap pixels are copied, so the bitmap may change or be deleted afterward. Without
+  // a bitmap, the object is drawn in a single color.
+  void create_object(uint16_t oid, uint16_t mid, DiBitmap* texture);
+
+  // Set the scale factors, rotation angles (in radians), and translation distances of an
+  // object. Only the given parts (bits 0, 1, and 2 of the mask for X, Y, and Z) change.
+  void set_object_scale(uint16_t oid, uint8_t mask, float x, float y, float z);
+  void set_object_rotation(uint16_t oid, uint8_t mask, float x, float y, float z);
+  void set_object_translation(uint16_t oid, uint8_t mask, float x, float y, float z);
+
   // Render the 3D image onto the bitmap.
   void render();
 
+  // Get this primitive as a 3D render.
+  virtual DiRender* as_render();
+
   protected:
+  // Get a mesh, creating it if needed.
+  DiRenderMesh* get_mesh(uint16_t mid);
+
+  // Get an object, or NULL if it does not exist.
+  DiRenderObject* get_object(uint16_t oid);
+
+  // Update the pingo mesh of an object to match its shared mesh, making the object
+  // invisible if the mesh is incomplete. Returns true if the object can be drawn.
+  bool prepare_object(DiRenderObject* object);
+
+  std::map<uint16_t, DiRenderMesh*>   m_meshes;   // meshes, by mesh ID
+  std::map<uint16_t, DiRenderObject*> m_objects;  // objects, by object ID
+  DiRenderBackEnd m_backend;                      // buffers used by pingo
+  TransformedVertex* m_vertex_cache;              // room to transform each vertex of a mesh once
+  uint32_t        m_vertex_cache_size;            // number of vertices that fit in the cache
 };
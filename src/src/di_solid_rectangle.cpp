@@ -39,6 +39,15 @@ void DiSolidRectangle::make_rectangle(uint16_t flags, int32_t x, int32_t y, uint
   m_paint_fcn.enter_and_leave_outer_function();
 }
 
+bool DiSolidRectangle::get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent) {
+  if (m_opaqueness < 100) {
+    return false;
+  }
+  x = m_draw_x;
+  x_extent = m_draw_x_extent;
+  return true;
+}
+
 void IRAM_ATTR DiSolidRectangle::delete_instructions() {
   m_paint_fcn.clear();
 }
@@ -37,6 +37,9 @@ class DiSolidRectangle: public DiPrimitive {
   // Draws a solid (filled) rectangle on the screen.
   void make_rectangle(uint16_t flags, int32_t x, int32_t y, uint32_t width, uint32_t height, uint8_t color);
 
+  // Get the horizontal span of pixels that are painted fully opaque on the given line.
+  virtual bool get_opaque_span(int32_t line_index, int32_t& x, int32_t& x_extent);
+
   // Clear the custom instructions needed to draw the primitive.
   virtual void IRAM_ATTR delete_instructions();
    
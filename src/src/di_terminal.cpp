@@ -27,14 +27,27 @@
 #include "di_terminal.h"
 #include <cstring>
 
+// Masks that select the pixels (bytes) of one 4-pixel word, for each 4-bit part of a font byte.
+static uint32_t s_nibble_masks[16];
+
 DiTerminal::DiTerminal(uint32_t x, uint32_t y, uint8_t flags,
                         uint32_t columns, uint32_t rows, const uint8_t* font) :
-  DiTileArray(ACT_PIXELS, ACT_LINES, columns, rows, 8, 8, flags) {
+  DiTileArray(ACT_PIXELS, ACT_LINES, columns, rows, 8, 8, flags, false) {
   m_current_column = 0;
   m_current_row = 0;
   m_fg_color = PIXEL_COLOR_ARGB(3, 1, 1, 0);
   m_bg_color = PIXEL_COLOR_ARGB(3, 0, 0, 0);
   m_font = font;
+
+  for (uint32_t nibble = 0; nibble < 16; nibble++) {
+    uint32_t mask = 0;
+    for (uint32_t pos = 0; pos < 4; pos++) {
+      if (nibble & (0x8 >> pos)) {
+        mask |= ((uint32_t)0xFF) << (FIX_INDEX(pos) * 8);
+      }
+    }
+    s_nibble_masks[nibble] = mask;
+  }
 }
 
 DiTerminal::~DiTerminal() {
@@ -50,7 +63,6 @@ void IRAM_ATTR DiTerminal::delete_instructions() {
   
 void IRAM_ATTR DiTerminal::generate_instructions() {
   delete_instructions();
-  DiTileArray::generate_instructions();
   auto cursor = get_first_child();
   if (cursor) {
     cursor->generate_instructions();
@@ -75,23 +87,13 @@ DiTileBitmapID DiTerminal::get_bitmap_id(uint8_t character, uint8_t fg_color, ui
 }
 
 DiTileBitmapID DiTerminal::define_character(uint8_t character, uint8_t fg_color, uint8_t bg_color) {
-  auto bm_id = get_bitmap_id(character, fg_color, bg_color);
-  if (m_id_to_bitmap_map.find(bm_id) == m_id_to_bitmap_map.end()) {
-    create_bitmap(bm_id);
-    uint32_t char_start = (uint32_t)character * 8;
-    for (int y = 0; y < 8; y++) {
-      uint8_t pixels = m_font[char_start+y];
-      for (int x = 0; x < 8; x++) {
-        if (pixels & 0x80) {
-          set_pixel(bm_id, x, y, fg_color);
-        } else {
-          set_pixel(bm_id, x, y, bg_color);
-        }
-        pixels <<= 1;
-      }
-    }
+  return get_bitmap_id(character, fg_color, bg_color);
+}
+
+void DiTerminal::set_character_id(int32_t column, int32_t row, DiTileBitmapID bm_id) {
+  if (column >= 0 && column < (int32_t)m_columns && row >= 0 && row < (int32_t)m_rows) {
+    m_tile_ids[get_cell(column, row)] = bm_id;
   }
-  return bm_id;
 }
 
 void DiTerminal::set_character_position(int32_t column, int32_t row) {
@@ -118,17 +120,22 @@ void DiTerminal::bring_current_position_into_view() {
   }
   if (m_current_row < 0) {
     // scroll text down (insert at the top)
-    int32_t move = m_rows + m_current_row;
     int32_t open = -m_current_row;
-    move_text(0, 0, m_columns, move, 0, open);
+    if (open > (int32_t)m_rows) {
+      open = m_rows;
+    }
+    scroll_rows(-open);
     erase_text(0, 0, m_columns, open);
     m_current_row = 0;
   }
   if (m_current_row >= m_rows) {
     // scroll text up (insert at the bottom)
     int32_t open = m_current_row - m_rows + 1;
-    int32_t move = m_rows -  open;
-    move_text(0, open, m_columns, move, 0, -open);
+    if (open > (int32_t)m_rows) {
+      open = m_rows;
+    }
+    int32_t move = m_rows - open;
+    scroll_rows(open);
     erase_text(0, move, m_columns, open);
     m_current_row = m_rows - 1;
   }
@@ -139,7 +146,7 @@ void DiTerminal::write_character(uint8_t character) {
 
   // Set the tile image ID using the character code.
   auto bm_id = get_bitmap_id(character);
-  set_tile(m_current_column, m_current_row, bm_id);
+  set_character_id(m_current_column, m_current_row, bm_id);
 
   // Advance the current position
   if (++m_current_column >= m_columns) {
@@ -149,8 +156,8 @@ void DiTerminal::write_character(uint8_t character) {
 }
 
 void DiTerminal::set_character(int32_t column, int32_t row, uint8_t character) {
-  auto bm_id = define_character(character, m_fg_color, m_bg_color);
-  set_tile(column, row, bm_id);
+  auto bm_id = get_bitmap_id(character);
+  set_character_id(column, row, bm_id);
 }
 
 DiTileBitmapID DiTerminal::read_character() {
@@ -181,8 +188,8 @@ void DiTerminal::move_text(int32_t column, int32_t row, int32_t columns, int32_t
       auto col = column;
       auto n = columns;
       while (n-- > 0) {
-        auto bm_id = get_tile(col, row);
-        set_tile(col++, row + delta_vert, bm_id);
+        copy_tile(col, row, col, row + delta_vert);
+        col++;
       }
       row--;
     }
@@ -192,8 +199,8 @@ void DiTerminal::move_text(int32_t column, int32_t row, int32_t columns, int32_t
       auto col = column;
       auto n = columns;
       while (n-- > 0) {
-        auto bm_id = get_tile(col, row);
-        set_tile(col++, row + delta_vert, bm_id);
+        copy_tile(col, row, col, row + delta_vert);
+        col++;
       }
       row++;
     }
@@ -270,4 +277,63 @@ void DiTerminal::move_cursor_tab(uint8_t x, uint8_t y) {
 void DiTerminal::get_position(uint16_t& column, uint16_t& row) {
   column = m_current_column;
   row = m_current_row;
-}
\ No newline at end of file
+}
+
+void IRAM_ATTR DiTerminal::paint(volatile uint32_t* p_scan_line, uint32_t line_index) {
+  auto y_offset_within_tile_array = (int32_t)line_index - m_abs_y;
+  auto y_offset_within_tile = y_offset_within_tile_array & 7;
+  auto row = y_offset_within_tile_array >> 3;
+  auto ids = m_tile_ids + ((row + m_row_base) % m_rows) * m_columns;
+  auto font = m_font + y_offset_within_tile;
+
+  if (((m_abs_x | m_draw_x | m_draw_x_extent) & 3) || (m_flags & PRIM_FLAGS_BLENDED)) {
+    paint_pixels((uint8_t*)p_scan_line, ids, font);
+    return;
+  }
+
+  // Each character cell is 2 words (8 pixels) wide, and the terminal starts on a word boundary.
+  int32_t word = (m_draw_x - m_abs_x + 3) >> 2;
+  int32_t end_word = (m_draw_x_extent - m_abs_x) >> 2;
+  if (end_word > (int32_t)m_columns * 2) {
+    end_word = m_columns * 2;
+  }
+  auto dst = (uint32_t*)p_scan_line + (m_abs_x >> 2);
+
+  while (word < end_word) {
+    auto bm_id = ids[word >> 1];
+    if (bm_id) {
+      uint32_t pixels = font[(bm_id & 0xFF) << 3];
+      uint32_t mask = s_nibble_masks[(word & 1) ? (pixels & 0xF) : (pixels >> 4)];
+      uint32_t fg = PIXEL_COLOR_X4(PIXEL_ALPHA_INV_MASK((uint8_t)(bm_id >> 16)));
+      uint32_t bg = PIXEL_COLOR_X4(PIXEL_ALPHA_INV_MASK((uint8_t)(bm_id >> 24)));
+      dst[word] = (fg & mask) | (bg & ~mask);
+    }
+    word++;
+  }
+}
+
+void IRAM_ATTR DiTerminal::paint_pixels(uint8_t* line_bytes, const DiTileBitmapID* ids, const uint8_t* font) {
+  bool blended = (m_flags & PRIM_FLAGS_BLENDED) != 0;
+  int32_t x_extent = m_draw_x_extent;
+  if (x_extent > m_abs_x + (int32_t)m_columns * 8) {
+    x_extent = m_abs_x + m_columns * 8;
+  }
+
+  for (int32_t x = m_draw_x; x < x_extent; x++) {
+    auto x_offset = x - m_abs_x;
+    auto bm_id = ids[x_offset >> 3];
+    if (!bm_id) {
+      continue;
+    }
+    uint8_t pixels = font[(bm_id & 0xFF) << 3];
+    uint8_t color = PIXEL_ALPHA_INV_MASK((uint8_t)(bm_id >> ((pixels & (0x80 >> (x_offset & 7))) ? 16 : 24)));
+    if (blended && (color & 0xC0)) {
+      // A fully transparent color leaves the pixel alone.
+      if ((color & 0xC0) != 0xC0) {
+        line_bytes[FIX_INDEX(x)] = blend_pixel(line_bytes[FIX_INDEX(x)], color);
+      }
+    } else {
+      line_bytes[FIX_INDEX(x)] = color;
+    }
+  }
+}
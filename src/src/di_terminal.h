@@ -3,6 +3,11 @@
 // A terminal is a specialized tile array, where each tile is a single character
 // cell, and the character codes are used as tile image IDs.
 //
+// The pixels of each character are expanded from the 1-bit-per-pixel font, using the
+// colors stored in the tile image ID, at the time that the character is painted.
+// No tile bitmaps are created, so memory use does not depend on the number of
+// color combinations that are used.
+//
 // Copyright (c) 2023 Curtis Whitley
 // 
 // Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -33,8 +38,8 @@ class DiTerminal: public DiTileArray {
   // Construct a terminal. The terminal always shows characters that are 8x8
   // pixels, based on the built-in Agon font.
   //
-  // The given x coordinate must be a multiple of 4, to align the terminal on
-  // a 4-byte boundary, which saves memory and processing time.
+  // A terminal whose x coordinate is a multiple of 4 is painted a word at a time.
+  // Otherwise, or if it is blended, it is painted a pixel at a time, which is slower.
   //
   DiTerminal(uint32_t x, uint32_t y, uint8_t flags, uint32_t columns, uint32_t rows, const uint8_t* font);
 
@@ -51,7 +56,8 @@ class DiTerminal: public DiTileArray {
   void define_character_range(uint8_t first_char, uint8_t last_char,
                               uint8_t fg_color, uint8_t bg_color);
 
-  // Define an individual character using given colors and 8x8 font.
+  // Define an individual character using given colors and 8x8 font. Because characters
+  // are drawn from the font when painted, this only determines the tile image ID.
   DiTileBitmapID define_character(uint8_t character, uint8_t fg_color, uint8_t bg_color);
 
   // Set the current character position. The position given may be within the terminal
@@ -104,6 +110,8 @@ class DiTerminal: public DiTileArray {
   // Bring a potentially off-screen position into view.
   void bring_current_position_into_view();
 
+  virtual void IRAM_ATTR paint(volatile uint32_t* p_scan_line, uint32_t line_index);
+
   protected:
   // Get the bitmap ID for a character, based on current colors.
   DiTileBitmapID get_bitmap_id(uint8_t character);
@@ -111,6 +119,12 @@ class DiTerminal: public DiTileArray {
   // Get the bitmap ID for a character, based on given colors.
   DiTileBitmapID get_bitmap_id(uint8_t character, uint8_t fg_color, uint8_t bg_color);
 
+  // Set the tile image ID at a specific row and column.
+  void set_character_id(int32_t column, int32_t row, DiTileBitmapID bm_id);
+
+  // Paint the characters of one line a pixel at a time, blending them if needed.
+  void IRAM_ATTR paint_pixels(uint8_t* line_bytes, const DiTileBitmapID* ids, const uint8_t* font);
+
   int32_t   m_current_column;
   int32_t   m_current_row;
   uint8_t   m_fg_color;
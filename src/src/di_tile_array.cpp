@@ -32,19 +32,20 @@
 
 DiTileArray::DiTileArray(uint32_t screen_width, uint32_t screen_height,
                       uint32_t columns, uint32_t rows,
-                      uint32_t tile_width, uint32_t tile_height, uint16_t flags) {
+                      uint32_t tile_width, uint32_t tile_height, uint16_t flags, bool tile_pixels) {
   m_tile_width = tile_width;
   m_tile_height = tile_height;
   m_rows = rows;
+  m_row_base = 0;
   m_columns = columns;
   m_flags = flags;
-  uint32_t draw_words_per_line = (tile_width + sizeof(uint32_t) - 1) / sizeof(uint32_t);
-  uint32_t words_per_line = draw_words_per_line;
+  uint32_t words_per_line = (tile_width + sizeof(uint32_t) - 1) / sizeof(uint32_t);
 
   if (flags & PRIM_FLAG_H_SCROLL_1) {
-    draw_words_per_line += 2;
+    words_per_line += 2; // matches the layout of each shifted copy in DiTileBitmap
   }
 
+  m_words_per_line = words_per_line;
   m_bytes_per_line = words_per_line * sizeof(uint32_t);
   uint32_t words_per_position = words_per_line * tile_height;
   m_bytes_per_position = words_per_position * sizeof(uint32_t);
@@ -62,9 +63,17 @@ DiTileArray::DiTileArray(uint32_t screen_width, uint32_t screen_height,
   m_width = tile_width * columns;
   m_height = tile_height * rows;
 
-  m_tile_pixels = new uint32_t*[rows * columns];
-  if (m_tile_pixels) {
-    memset(m_tile_pixels, 0, rows * columns * sizeof(uint32_t*));
+  m_tile_pixels = NULL;
+  if (tile_pixels) {
+    m_tile_pixels = new uint32_t*[rows * columns];
+    if (m_tile_pixels) {
+      memset(m_tile_pixels, 0, rows * columns * sizeof(uint32_t*));
+    }
+  }
+
+  m_tile_ids = new DiTileBitmapID[rows * columns];
+  if (m_tile_ids) {
+    memset(m_tile_ids, 0, rows * columns * sizeof(DiTileBitmapID));
   }
 }
 
@@ -76,15 +85,15 @@ DiTileArray::~DiTileArray() {
   if (m_tile_pixels) {
     delete [] m_tile_pixels;
   }
+
+  if (m_tile_ids) {
+    delete [] m_tile_ids;
+  }
 }
 
 void IRAM_ATTR DiTileArray::delete_instructions() {
-  if (m_flags & PRIM_FLAG_H_SCROLL_1) {
-    for (uint32_t pos = 0; pos < 4; pos++) {
-      m_paint_fcn[pos].clear();
-    }
-  } else {
-    m_paint_fcn[0].clear();
+  for (uint32_t pos = 0; pos < 4; pos++) {
+    m_paint_fcn[pos].clear();
   }
 }
 
@@ -95,73 +104,60 @@ void IRAM_ATTR DiTileArray::generate_instructions() {
   // a0 = return address
   // a1 = stack ptr
   // a2 = p_this
-  // a3 = p_scan_line
-  // a4 = line_index
-  // a5 = a5_value (pointer to array of src_pixel pointers for 1 row)
-  // a6 = a6_value (src_pixels_offset)
-  // m_paint_fcn->call_a5_a6(this, p_scan_line, y_offset_within_tile, row_array, src_pixels_offset);
+  // a3 = p_dst (word-aligned start of the first whole tile, minus its pixel offset)
+  // a4 = number of whole tiles to draw
+  // a5 = pointer to the src_pixel pointer of the first tile
+  // a6 = offset of the line of source pixels within each tile bitmap
+  // m_paint_fcn[pos].call_a5_a6(this, p_dst, num_tiles, p_tile_pixels, src_pixels_offset);
+  //
+  // With a pixel offset, each tile uses the bitmap copy shifted by the same offset,
+  // so its pixels occupy part of its first and last words, and all of the others.
+  // Only the pixels of the tile are written, so empty cells stay untouched.
 
-  if (m_flags & PRIM_FLAG_H_SCROLL_1) {
-    for (uint32_t pos = 0; pos < 4; pos++) {
-      m_paint_fcn[pos].entry(REG_STACK_PTR, 32);
-      m_paint_fcn[pos].retw();
+  if ((m_tile_width & 3) || m_tile_width > 128) {
+    return; // painted by the C++ code instead
+  }
+
+  uint32_t num_fcns = (m_flags & PRIM_FLAG_H_SCROLL_1) ? 4 : 1;
+  uint32_t last_word = m_tile_width / 4;
+  for (uint32_t pos = 0; pos < num_fcns; pos++) {
+    auto fcn = &m_paint_fcn[pos];
+    fcn->entry(REG_STACK_PTR, 32);
+    if (pos) {
+      fcn->ssai(16); // needed by store_shifted_pixels
     }
-  } else {
-    m_paint_fcn[0].entry(REG_STACK_PTR, 32);
-
-    //m_paint_fcn[0].movi(a11, 0x3F);
-    //m_paint_fcn[0].s32i(a11, a3, 4);
-    //m_paint_fcn[0].retw();
-
-    m_paint_fcn[0].movi(a12, m_visible_columns); // a12 <-- loop counter (# of visible columns)
-    auto at_loop = m_paint_fcn[0].get_code_index();
-    m_paint_fcn[0].loop(a12, 0); // loop once per column
-
-    m_paint_fcn[0].l32i(a10, a5, 0); // a10 <-- points to start of pixels for 1 bitmap
-    auto at_branch = m_paint_fcn[0].get_code_index();
-    m_paint_fcn[0].beqz(a10, 0); // go if the tile cell is empty (null)
-    m_paint_fcn[0].add(a10, a10, a6); // a10 <-- points to line of source pixels for 1 bitmap
-    for (uint32_t x = 0; x < m_tile_width; x+=4) {
-      m_paint_fcn[0].l32i(a11, a10, x);
-      m_paint_fcn[0].s32i(a11, a3, x);
-    }
-    uint32_t x = m_tile_width;
-    while (x) {
-      if (x < 124) {
-        m_paint_fcn[0].addi(a3, a3, x);
-        break;
-      }
-      m_paint_fcn[0].addi(a3, a3, 124);
-      x -= 124;
-    }
-    m_paint_fcn[0].bgez_to_here(a10, at_branch);
-    m_paint_fcn[0].addi(a5, a5, 4);
-
-    m_paint_fcn[0].loop_to_here(a12, at_loop);
-    m_paint_fcn[0].retw();
-
-    /*
-    old code. remove later.
-    //if (!done) debug_log(" row=%i", row);
-    auto start_x_offset_within_tile_array = m_draw_x - m_abs_x;
-    auto start_column = (start_x_offset_within_tile_array + m_tile_width - 1) / m_tile_width;
-    auto end_x_offset_within_tile_array = m_draw_x_extent - m_abs_x;
-    auto end_column = end_x_offset_within_tile_array / m_tile_width;
-    auto fcn_index = m_draw_x & 0x3;
-    uint32_t draw_x = m_draw_x & 0xFFFFFFFC;
-    auto src_pixels_offset = fcn_index * m_bytes_per_position + y_offset_within_tile * m_bytes_per_line;
-    //if (!done) debug_log(" sx=%i sc=%i ex=%i ec=%i drx=%i yot=%i spo=%u",
-    //  start_x_offset_within_tile_array, start_column, end_x_offset_within_tile_array, end_column, draw_x, y_offset_within_tile, src_pixels_offset);
-    auto p_tile_bitmaps = &m_tile_pixels[row * m_columns];
-    for (uint32_t col = 0; col < m_columns; col++) {
-      auto p_tile_bitmap = *p_tile_bitmaps++;
-      if (p_tile_bitmap) {
-        //if (!done) debug_log(" paint col=%i drx=%u", col, draw_x);
-      }
-      draw_x += m_tile_width;
+    auto at_exit = fcn->get_code_index();
+    fcn->beqz(a4, 0); // go if there are no tiles to draw
+
+    auto at_loop = fcn->get_code_index();
+    fcn->l32i(a8, a5, 0); // a8 <-- points to start of pixels for 1 bitmap
+    fcn->addi(a5, a5, 4);
+    auto at_empty = fcn->get_code_index();
+    fcn->beqz(a8, 0); // go if the tile cell is empty (null)
+    fcn->add(a8, a8, a6); // a8 <-- points to line of source pixels for 1 bitmap
+
+    if (pos) {
+      fcn->l32i(a15, a8, 0);
+      fcn->store_shifted_pixels(pos, 3, a15, a3, 0);
+    } else {
+      fcn->l32i(a9, a8, 0);
+      fcn->s32i(a9, a3, 0);
+    }
+    for (uint32_t word = 1; word < last_word; word++) {
+      fcn->l32i(a9, a8, word * 4);
+      fcn->s32i(a9, a3, word * 4);
+    }
+    if (pos) {
+      fcn->l32i(a15, a8, last_word * 4);
+      fcn->store_shifted_pixels(0, pos - 1, a15, a3, last_word * 4);
     }
-    //if (!done) debug_log("\n");
-    //done=true;*/
+
+    fcn->bgez_to_here(a8, at_empty);
+    fcn->add_to_reg(a3, m_tile_width);
+    fcn->addi(a4, a4, -1);
+    fcn->bnez(a4, at_loop - fcn->get_code_index() - 4);
+    fcn->bgez_to_here(a4, at_exit);
+    fcn->retw();
   }
 }
 
@@ -183,47 +179,160 @@ void DiTileArray::set_pixel(DiTileBitmapID bm_id, int32_t x, int32_t y, uint8_t
 void DiTileArray::set_tile(int16_t column, int16_t row, DiTileBitmapID bm_id) {
   auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
   if (bitmap_item != m_id_to_bitmap_map.end()) {
-    m_tile_pixels[row * m_columns + column] = bitmap_item->second->get_pixels();
+    auto cell = get_cell(column, row);
+    if (m_tile_pixels) {
+      m_tile_pixels[cell] = bitmap_item->second->get_pixels();
+    }
+    m_tile_ids[cell] = bm_id;
   }
 }
 
 void DiTileArray::set_tiles(int16_t column, int16_t row, DiTileBitmapID bm_id,
                                   int16_t columns, int16_t rows) {
-  while (rows-- > 0) {
-    auto cols = columns;
-    auto col = column;
-    while (cols-- > 0) {
-      set_tile(col++, row, bm_id);
+  auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+  int32_t col = column, rw = row, cols = columns, rws = rows;
+  if (bitmap_item == m_id_to_bitmap_map.end() ||
+      !clip_tile_region(m_columns, m_rows, col, rw, cols, rws)) {
+    return;
+  }
+  // The bitmap is found once for the whole rectangle.
+  auto pixels = bitmap_item->second->get_pixels();
+  while (rws--) {
+    auto cell = get_cell(col, rw++);
+    for (int32_t i = 0; i < cols; i++) {
+      if (m_tile_pixels) {
+        m_tile_pixels[cell + i] = pixels;
+      }
+      m_tile_ids[cell + i] = bm_id;
     }
-    row++;
   }
 }
 
 void DiTileArray::unset_tiles(int16_t column, int16_t row, int16_t columns, int16_t rows) {
-  while (rows-- > 0) {
-    auto cols = columns;
-    auto col = column;
-    while (cols-- > 0) {
-      unset_tile(col++, row);
+  int32_t col = column, rw = row, cols = columns, rws = rows;
+  if (!clip_tile_region(m_columns, m_rows, col, rw, cols, rws)) {
+    return;
+  }
+  while (rws--) {
+    auto cell = get_cell(col, rw++);
+    if (m_tile_pixels) {
+      memset(&m_tile_pixels[cell], 0, cols * sizeof(uint32_t*));
+    }
+    memset(&m_tile_ids[cell], 0, cols * sizeof(DiTileBitmapID));
+  }
+}
+
+void DiTileArray::set_tile_block(int16_t column, int16_t row, int16_t columns, int16_t rows,
+                                  const uint8_t* bm_ids) {
+  // Neighboring cells often use the same bitmap, so the last one found is kept.
+  DiTileBitmapID last_id = 0;
+  uint32_t* last_pixels = NULL;
+  for (int32_t rw = row; rw < row + rows; rw++) {
+    for (int32_t col = column; col < column + columns; col++) {
+      DiTileBitmapID bm_id = bm_ids[0] | ((DiTileBitmapID)bm_ids[1] << 8);
+      bm_ids += 2;
+      if (col < 0 || col >= (int32_t)m_columns || rw < 0 || rw >= (int32_t)m_rows) {
+        continue;
+      }
+      if (bm_id && bm_id != last_id) {
+        auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+        if (bitmap_item == m_id_to_bitmap_map.end()) {
+          continue;
+        }
+        last_id = bm_id;
+        last_pixels = bitmap_item->second->get_pixels();
+      }
+      auto cell = get_cell(col, rw);
+      if (m_tile_pixels) {
+        m_tile_pixels[cell] = (bm_id ? last_pixels : NULL);
+      }
+      m_tile_ids[cell] = bm_id;
+    }
+  }
+}
+
+void DiTileArray::copy_tiles(int16_t src_column, int16_t src_row, int16_t columns, int16_t rows,
+                              int16_t dst_column, int16_t dst_row, bool move) {
+  int32_t sc = src_column, sr = src_row, dc = dst_column, dr = dst_row, cols = columns, rws = rows;
+  if (!clip_tile_copy(m_columns, m_rows, sc, sr, dc, dr, cols, rws)) {
+    return;
+  }
+
+  // Copy in the direction that reads each overlapping cell before overwriting it.
+  bool backward_rows = (dr > sr);
+  bool backward_columns = (dc > sc);
+  for (int32_t i = 0; i < rws; i++) {
+    int32_t r = (backward_rows ? rws - 1 - i : i);
+    for (int32_t j = 0; j < cols; j++) {
+      int32_t c = (backward_columns ? cols - 1 - j : j);
+      copy_tile(sc + c, sr + r, dc + c, dr + r);
+    }
+  }
+
+  if (move) {
+    for (int32_t r = 0; r < rws; r++) {
+      for (int32_t c = 0; c < cols; c++) {
+        int32_t col = sc + c;
+        int32_t rw = sr + r;
+        if (col < dc || col >= dc + cols || rw < dr || rw >= dr + rws) {
+          unset_tile(col, rw);
+        }
+      }
     }
-    row++;
   }
 }
 
 void DiTileArray::unset_tile(int16_t column, int16_t row) {
-    m_tile_pixels[row * m_columns + column] = NULL;
+    auto cell = get_cell(column, row);
+    if (m_tile_pixels) {
+      m_tile_pixels[cell] = NULL;
+    }
+    m_tile_ids[cell] = 0;
 }
 
 DiTileBitmapID DiTileArray::get_tile(int16_t column, int16_t row) {
-  auto tile_pixels = m_tile_pixels[row * m_columns + column];
-  if (tile_pixels) {
-    for (auto bitmap_item = m_id_to_bitmap_map.begin(); bitmap_item != m_id_to_bitmap_map.end(); bitmap_item++) {
-      if (tile_pixels == bitmap_item->second->get_pixels()) {
-        return bitmap_item->second->get_id();
-      }
+  return m_tile_ids[get_cell(column, row)];
+}
+
+void DiTileArray::copy_tile(int16_t src_column, int16_t src_row, int16_t dst_column, int16_t dst_row) {
+  auto src_cell = get_cell(src_column, src_row);
+  auto dst_cell = get_cell(dst_column, dst_row);
+  if (m_tile_pixels) {
+    m_tile_pixels[dst_cell] = m_tile_pixels[src_cell];
+  }
+  m_tile_ids[dst_cell] = m_tile_ids[src_cell];
+}
+
+void DiTileArray::clear_row(uint32_t physical_row) {
+  auto cell = physical_row * m_columns;
+  if (m_tile_pixels) {
+    memset(&m_tile_pixels[cell], 0, m_columns * sizeof(uint32_t*));
+  }
+  memset(&m_tile_ids[cell], 0, m_columns * sizeof(DiTileBitmapID));
+}
+
+void DiTileArray::scroll_rows(int32_t rows) {
+  if (rows >= (int32_t)m_rows || rows <= -(int32_t)m_rows) {
+    for (uint32_t row = 0; row < m_rows; row++) {
+      clear_row(row);
+    }
+    return;
+  }
+
+  if (rows > 0) {
+    // The top rows become the bottom rows.
+    m_row_base = (m_row_base + rows) % m_rows;
+    for (int32_t row = m_rows - rows; row < (int32_t)m_rows; row++) {
+      clear_row((row + m_row_base) % m_rows);
+    }
+  } else if (rows < 0) {
+    // The bottom rows become the top rows.
+    rows = -rows;
+    m_row_base = (m_row_base + m_rows - rows) % m_rows;
+    for (int32_t row = 0; row < rows; row++) {
+      clear_row((row + m_row_base) % m_rows);
     }
   }
-  return (DiTileBitmapID)0;
 }
 
 void DiTileArray::get_tile_coordinates(int16_t column, int16_t row,
@@ -234,11 +343,64 @@ void DiTileArray::get_tile_coordinates(int16_t column, int16_t row,
     y_extent = y + m_tile_height;
 }
 
+void IRAM_ATTR DiTileArray::paint_tile_pixels(uint8_t* line_bytes, int32_t x, uint32_t* pixels,
+                  uint32_t y_offset_within_tile, uint32_t x_offset_within_tile, uint32_t width) {
+  if (pixels) {
+    // The first copy of the bitmap pixels is not shifted.
+    auto src_bytes = (uint8_t*)(pixels + y_offset_within_tile * m_words_per_line);
+    while (width--) {
+      line_bytes[FIX_INDEX(x)] = src_bytes[FIX_INDEX(x_offset_within_tile)];
+      x++;
+      x_offset_within_tile++;
+    }
+  }
+}
+
 void IRAM_ATTR DiTileArray::paint(volatile uint32_t* p_scan_line, uint32_t line_index) {
   auto y_offset_within_tile_array = (int32_t)line_index - m_abs_y;
   auto y_offset_within_tile = y_offset_within_tile_array % (int32_t)m_tile_height;
   auto row = y_offset_within_tile_array / (int32_t)m_tile_height;
-  auto src_pixels_offset = y_offset_within_tile * m_bytes_per_line;
-  auto row_array = (uint32_t)(m_tile_pixels + row * m_columns);
-  m_paint_fcn[0].call_a5_a6(this, p_scan_line, y_offset_within_tile, row_array, src_pixels_offset);
+  auto tile_row = m_tile_pixels + ((row + m_row_base) % m_rows) * m_columns;
+
+  int32_t x = m_draw_x;
+  int32_t x_extent = m_draw_x_extent;
+  uint32_t x_offset_within_tile_array = x - m_abs_x;
+  uint32_t column = x_offset_within_tile_array / m_tile_width;
+  uint32_t x_offset_within_tile = x_offset_within_tile_array - column * m_tile_width;
+  auto line_bytes = (uint8_t*)p_scan_line;
+
+  // Draw the visible part of a tile cut off by the left edge.
+  if (x_offset_within_tile && x < x_extent) {
+    uint32_t width = MIN(m_tile_width - x_offset_within_tile, (uint32_t)(x_extent - x));
+    paint_tile_pixels(line_bytes, x, tile_row[column], y_offset_within_tile, x_offset_within_tile, width);
+    x += width;
+    column++;
+  }
+
+  // Draw the whole tiles.
+  uint32_t num_tiles = (x < x_extent) ? (x_extent - x) / m_tile_width : 0;
+  if (num_tiles > m_columns - column) {
+    num_tiles = m_columns - column;
+  }
+  if (num_tiles) {
+    uint32_t pos = x & 3;
+    if (m_paint_fcn[pos].get_code_size()) {
+      auto src_pixels_offset = pos * m_bytes_per_position + y_offset_within_tile * m_bytes_per_line;
+      m_paint_fcn[pos].call_a5_a6(this, (volatile uint32_t*)(line_bytes + x - pos), num_tiles,
+        (uint32_t)(tile_row + column), src_pixels_offset);
+      x += num_tiles * m_tile_width;
+      column += num_tiles;
+    } else {
+      // There is no code for this pixel offset (e.g., without PRIM_FLAG_H_SCROLL_1).
+      while (num_tiles--) {
+        paint_tile_pixels(line_bytes, x, tile_row[column++], y_offset_within_tile, 0, m_tile_width);
+        x += m_tile_width;
+      }
+    }
+  }
+
+  // Draw the visible part of a tile cut off by the right edge.
+  if (x < x_extent && column < m_columns) {
+    paint_tile_pixels(line_bytes, x, tile_row[column], y_offset_within_tile, 0, x_extent - x);
+  }
 }
@@ -42,10 +42,11 @@ typedef std::map<DiTileBitmapID, DiTileBitmap*> DiTileIdToBitmapMap;
 
 class DiTileArray: public DiPrimitive {
   public:
-  // Construct a tile array.
+  // Construct a tile array. Without tile pixels, only the tile IDs of the cells are kept,
+  // and a derived class must paint the cells itself.
   DiTileArray(uint32_t screen_width, uint32_t screen_height,
             uint32_t columns, uint32_t rows,
-            uint32_t tile_width, uint32_t tile_height, uint16_t flags);
+            uint32_t tile_width, uint32_t tile_height, uint16_t flags, bool tile_pixels);
 
   // Destroy a tile array.
   virtual ~DiTileArray();
@@ -69,15 +70,33 @@ class DiTileArray: public DiPrimitive {
   // Unset the bitmap ID at a specific row and column, to remove the tile.
   void unset_tile(int16_t column, int16_t row);
 
-  // Set the bitmap ID to use to fill a rectangle of tiles.
+  // Set the bitmap ID to use to fill a rectangle of tiles. Cells outside the array are ignored.
   void set_tiles(int16_t column, int16_t row, DiTileBitmapID bm_id, int16_t columns, int16_t rows);
 
-  // Unset the bitmap IDs to remove a rectangle of tiles.
+  // Unset the bitmap IDs to remove a rectangle of tiles. Cells outside the array are ignored.
   void unset_tiles(int16_t column, int16_t row, int16_t columns, int16_t rows);
 
+  // Set the bitmap IDs of a rectangle of tiles, from 16-bit IDs (low byte first) in row-major
+  // order. An ID of 0 removes the tile, and an unknown ID leaves the cell unchanged.
+  void set_tile_block(int16_t column, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids);
+
+  // Copy a rectangle of tiles (or the lack of them) to another position, as if through a
+  // temporary copy, so the rectangles may overlap. When moving, the source cells that are
+  // not overwritten are emptied.
+  void copy_tiles(int16_t src_column, int16_t src_row, int16_t columns, int16_t rows,
+                  int16_t dst_column, int16_t dst_row, bool move);
+
   // Get the bitmap ID presently at the given row and column.
   DiTileBitmapID get_tile(int16_t column, int16_t row);
 
+  // Copy the tile (or the lack of one) at one row and column to another row and column.
+  void copy_tile(int16_t src_column, int16_t src_row, int16_t dst_column, int16_t dst_row);
+
+  // Scroll all rows vertically by the given number of rows, by rotating the row base rather
+  // than moving tiles. A positive count moves the rows up (exposing rows at the bottom), and
+  // a negative count moves them down (exposing rows at the top). Exposed rows are left empty.
+  void scroll_rows(int32_t rows);
+
   // Get the coordinates of a specific tile position.
   void get_tile_coordinates(int16_t column, int16_t row,
             int16_t& x, int16_t& y, int16_t& x_extent, int16_t& y_extent);
@@ -85,8 +104,22 @@ class DiTileArray: public DiPrimitive {
   virtual void IRAM_ATTR paint(volatile uint32_t* p_scan_line, uint32_t line_index);
 
   protected:
+  // Get the index of the cell at the given row and column, taking the row base into account.
+  inline uint32_t get_cell(int16_t column, int16_t row) {
+    return ((row + m_row_base) % m_rows) * m_columns + column;
+  }
+
+  // Empty the tile cells in the given (physical) row.
+  void clear_row(uint32_t physical_row);
+
+  // Copy some pixels of one tile, one byte at a time (used at the edges of a line).
+  void IRAM_ATTR paint_tile_pixels(uint8_t* line_bytes, int32_t x, uint32_t* pixels,
+                                  uint32_t y_offset_within_tile, uint32_t x_offset_within_tile, uint32_t width);
+
   uint32_t  m_columns;              // number of columns (cells in each row)
   uint32_t  m_rows;                 // number of rows (cells in each column)
+  uint32_t  m_row_base;             // physical row that holds logical row 0 (circular)
+  uint32_t  m_words_per_line;       // number of 4-pixel words in each bitmap line
   uint32_t  m_bytes_per_line;       // number of 1-pixel bytes in each bitmap line
   uint32_t  m_bytes_per_position;   // number of 1-pixel bytes in each bitmap position
   uint32_t  m_visible_columns;      // number of columns that fit on the screen
@@ -95,6 +128,7 @@ class DiTileArray: public DiPrimitive {
   uint32_t  m_tile_height;          // height of 1 tile in pixels
   uint8_t   m_transparent_color;    // value indicating not to draw the pixel
   DiTileIdToBitmapMap m_id_to_bitmap_map; // caches bitmaps based on bitmap ID
-  uint32_t** m_tile_pixels;         // 2D array of tile bitmap IDs
-  EspFunction m_paint_fcn[4];       // dynamic code to copy pixel data
+  uint32_t** m_tile_pixels;         // 2D array of tile bitmap pixel pointers (NULL if not kept)
+  DiTileBitmapID* m_tile_ids;       // 2D array of tile bitmap IDs (parallel to m_tile_pixels)
+  EspFunction m_paint_fcn[4];       // dynamic code to copy whole tiles, per pixel offset
 };
@@ -94,6 +94,7 @@ void DiTileBitmap::set_pixel(int32_t x, int32_t y, uint8_t color) {
 
 DiPaintableTileBitmap::DiPaintableTileBitmap(DiTileBitmapID bm_id, uint32_t width, uint32_t height, uint16_t flags) :
   DiTileBitmap(bm_id, width, height, flags) {
+  m_index = 0;
 }
 
 DiPaintableTileBitmap::~DiPaintableTileBitmap() {
@@ -39,6 +39,47 @@
 
 typedef uint32_t DiTileBitmapID;
 
+// Clip a rectangle of tile cells to a grid of the given size. Returns false if no cells remain.
+static inline bool clip_tile_region(uint32_t grid_columns, uint32_t grid_rows,
+                  int32_t& column, int32_t& row, int32_t& columns, int32_t& rows) {
+  if (column < 0) {
+    columns += column;
+    column = 0;
+  }
+  if (row < 0) {
+    rows += row;
+    row = 0;
+  }
+  // The sums are 64-bit, so that no region size can wrap around.
+  if ((int64_t)column + columns > (int64_t)grid_columns) {
+    columns = (int32_t)((int64_t)grid_columns - column);
+  }
+  if ((int64_t)row + rows > (int64_t)grid_rows) {
+    rows = (int32_t)((int64_t)grid_rows - row);
+  }
+  return columns > 0 && rows > 0;
+}
+
+// Clip the source and destination rectangles of a tile copy to a grid of the given size,
+// keeping them the same size. Returns false if no cells remain.
+static inline bool clip_tile_copy(uint32_t grid_columns, uint32_t grid_rows,
+                  int32_t& src_column, int32_t& src_row, int32_t& dst_column, int32_t& dst_row,
+                  int32_t& columns, int32_t& rows) {
+  int32_t dx = dst_column - src_column;
+  int32_t dy = dst_row - src_row;
+  if (!clip_tile_region(grid_columns, grid_rows, src_column, src_row, columns, rows)) {
+    return false;
+  }
+  dst_column = src_column + dx;
+  dst_row = src_row + dy;
+  if (!clip_tile_region(grid_columns, grid_rows, dst_column, dst_row, columns, rows)) {
+    return false;
+  }
+  src_column = dst_column - dx;
+  src_row = dst_row - dy;
+  return true;
+}
+
 class DiTileBitmap {
   public:
   // Construct a bitmap.
@@ -67,6 +108,9 @@ class DiTileBitmap {
   // Get a pointer to the pixel data.
   inline uint32_t* get_pixels() { return m_pixels; }
 
+  // Get the color value that represents a transparent pixel (with inverted alpha bits).
+  inline uint8_t get_transparent_color() { return m_transparent_color; }
+
   protected:
   // Set a single pixel with an adjusted color value.
   void set_pixel(int32_t x, int32_t y, uint8_t color);
@@ -92,6 +136,10 @@ class DiPaintableTileBitmap : public DiTileBitmap {
   // Destroy a paintable tile bitmap.
   ~DiPaintableTileBitmap();
 
+  // Get or set the index of the bitmap within the bitmap table of its tile map.
+  inline uint16_t get_index() { return m_index; }
+  inline void set_index(uint16_t index) { m_index = index; }
+
   // Clear the custom instructions needed to draw the primitive.
   void IRAM_ATTR delete_instructions();
    
@@ -103,4 +151,5 @@ class DiPaintableTileBitmap : public DiTileBitmap {
 
   protected:
   EspFunction m_paint_fcn[4];
+  uint16_t    m_index;
 };
@@ -28,6 +28,7 @@
 // 
 
 #include "di_tile_map.h"
+#include "esp_heap_caps.h"
 #include <cstring>
 
 DiTileMap::DiTileMap(uint32_t screen_width, uint32_t screen_height,
@@ -38,13 +39,14 @@ DiTileMap::DiTileMap(uint32_t screen_width, uint32_t screen_height,
   m_rows = rows;
   m_columns = columns;
   m_flags = flags;
-  uint32_t draw_words_per_line = (tile_width + sizeof(uint32_t) - 1) / sizeof(uint32_t);
-  uint32_t words_per_line = draw_words_per_line;
+  uint32_t words_per_line = (tile_width + sizeof(uint32_t) - 1) / sizeof(uint32_t);
 
   if (flags & PRIM_FLAG_H_SCROLL_1) {
-    draw_words_per_line += 2;
+    // This matches the layout of the shifted copies in the tile bitmaps.
+    words_per_line += 2;
   }
 
+  m_words_per_line = words_per_line;
   m_bytes_per_line = words_per_line * sizeof(uint32_t);
   uint32_t words_per_position = words_per_line * tile_height;
   m_bytes_per_position = words_per_position * sizeof(uint32_t);
@@ -61,15 +63,40 @@ DiTileMap::DiTileMap(uint32_t screen_width, uint32_t screen_height,
 
   m_width = tile_width * columns;
   m_height = tile_height * rows;
+
+  m_scroll_x = 0;
+  m_scroll_y = 0;
+  m_line_table = NULL;
+  m_has_flipped_tiles = false;
+  m_world = NULL;
+  m_world_columns = 0;
+  m_world_rows = 0;
+  m_window_valid = false;
+
+  // Tile index 0 means that a cell has no tile.
+  m_bitmaps.push_back(NULL);
+  m_shown_bitmaps.push_back(NULL);
+  m_bitmap_pixels.push_back(NULL);
+  m_pixel_table = m_bitmap_pixels.data();
+
+  // The tile indexes of a row are allocated when the first tile in the row is set,
+  // so that a large, mostly empty map takes little memory.
+  m_tile_rows = new DiTileIndex*[rows];
+  memset(m_tile_rows, 0, rows * sizeof(DiTileIndex*));
+
+  generate_row_painters();
 }
 
 DiTileMap::~DiTileMap() {
   for (auto bitmap_item = m_id_to_bitmap_map.begin(); bitmap_item != m_id_to_bitmap_map.end(); bitmap_item++) {
     delete bitmap_item->second;
   }
-  for (auto map = m_row_to_col_map.begin(); map != m_row_to_col_map.end(); map++) {
-    delete map->second;
+  for (uint32_t row = 0; row < m_rows; row++) {
+    delete [] m_tile_rows[row];
   }
+  delete [] m_tile_rows;
+  delete [] m_line_table;
+  free_world();
 }
 
 void IRAM_ATTR DiTileMap::delete_instructions() {
@@ -84,11 +111,94 @@ void IRAM_ATTR DiTileMap::generate_instructions() {
   }
 }
 
+void DiTileMap::generate_row_painters() {
+  // Painting is done with this parameter list:
+  // a0 = return address
+  // a1 = stack ptr
+  // a2 = p_this
+  // a3 = p_dst (word-aligned start of the first whole tile, minus its pixel offset)
+  // a4 = number of whole tiles to draw
+  // a5 = pointer to the tile index of the first tile
+  // a6 = offset of the line of source pixels within each tile bitmap
+  // m_row_fcn[pos].call_a5_a6(this, p_dst, num_tiles, p_tile_indexes, src_pixels_offset);
+  //
+  // With a pixel offset, each tile uses the bitmap copy shifted by the same offset,
+  // so its pixels occupy part of its first and last words, and all of the others.
+  // Only the pixels of the tile are written, so empty cells stay untouched.
+
+  if ((m_tile_width & 3) || m_tile_width > 128) {
+    return; // painted by the C++ code instead
+  }
+
+  uint32_t num_fcns = (m_flags & PRIM_FLAG_H_SCROLL_1) ? 4 : 1;
+  uint32_t last_word = m_tile_width / 4;
+  for (uint32_t pos = 0; pos < num_fcns; pos++) {
+    auto fcn = &m_row_fcn[pos];
+    auto at_jump = fcn->enter_outer_function();
+    fcn->begin_data();
+    auto at_table = fcn->d32((uint32_t)&m_pixel_table);
+    fcn->begin_code(at_jump);
+    fcn->l32r_from(a7, at_table);
+    fcn->l32i(a7, a7, 0); // a7 <-- table of bitmap pixel pointers
+    if (pos) {
+      fcn->ssai(16); // needed by store_shifted_pixels
+    }
+    auto at_exit = fcn->get_code_index();
+    fcn->beqz(a4, 0); // go if there are no tiles to draw
+
+    auto at_loop = fcn->get_code_index();
+    fcn->l16ui(a8, a5, 0); // a8 <-- tile index
+    fcn->addi(a5, a5, 2);
+    auto at_empty = fcn->get_code_index();
+    fcn->beqz(a8, 0); // go if the tile cell is empty
+    fcn->srli(a9, a8, 14); // a9 <-- flip bits
+    auto at_flipped = fcn->get_code_index();
+    fcn->bnez(a9, 0); // go if the tile is flipped (drawn by the C++ code)
+    fcn->slli(a8, a8, 2);
+    fcn->add(a8, a8, a7);
+    fcn->l32i(a8, a8, 0); // a8 <-- points to start of pixels for 1 bitmap
+    fcn->add(a8, a8, a6); // a8 <-- points to line of source pixels for 1 bitmap
+
+    if (pos) {
+      fcn->l32i(a15, a8, 0);
+      fcn->store_shifted_pixels(pos, 3, a15, a3, 0);
+    } else {
+      fcn->l32i(a9, a8, 0);
+      fcn->s32i(a9, a3, 0);
+    }
+    for (uint32_t word = 1; word < last_word; word++) {
+      fcn->l32i(a9, a8, word * 4);
+      fcn->s32i(a9, a3, word * 4);
+    }
+    if (pos) {
+      fcn->l32i(a15, a8, last_word * 4);
+      fcn->store_shifted_pixels(0, pos - 1, a15, a3, last_word * 4);
+    }
+
+    fcn->bgez_to_here(a8, at_empty);
+    fcn->bnez_to_here(a9, at_flipped);
+    fcn->add_to_reg(a3, m_tile_width);
+    fcn->addi(a4, a4, -1);
+    fcn->bnez(a4, at_loop - fcn->get_code_index() - 4);
+    fcn->bgez_to_here(a4, at_exit);
+    fcn->retw();
+  }
+}
+
 DiTileBitmap* DiTileMap::create_bitmap(DiTileBitmapID bm_id) {
   auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
   if (bitmap_item == m_id_to_bitmap_map.end()) {
+    // A larger index would overlap the flip bits of a cell.
+    if (m_bitmaps.size() > TILE_INDEX_MASK) {
+      return NULL;
+    }
     auto bitmap = new DiPaintableTileBitmap(bm_id, m_tile_width, m_tile_height, m_flags);
     m_id_to_bitmap_map[bm_id] = bitmap;
+    bitmap->set_index((DiTileIndex)m_bitmaps.size());
+    m_bitmaps.push_back(bitmap);
+    m_shown_bitmaps.push_back(bitmap);
+    m_bitmap_pixels.push_back(bitmap->get_pixels());
+    m_pixel_table = m_bitmap_pixels.data();
     return bitmap;
   } else {
     return bitmap_item->second;
@@ -96,74 +206,581 @@ DiTileBitmap* DiTileMap::create_bitmap(DiTileBitmapID bm_id) {
 }
 
 void DiTileMap::set_pixel(DiTileBitmapID bm_id, int32_t x, int32_t y, uint8_t color) {
-  m_id_to_bitmap_map[bm_id]->set_transparent_pixel(x, y, color);
+  auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+  if (bitmap_item != m_id_to_bitmap_map.end()) {
+    bitmap_item->second->set_transparent_pixel(x, y, color);
+  }
 }
 
 void DiTileMap::set_tile(int16_t column, int16_t row, DiTileBitmapID bm_id) {
+  if (column < 0 || column >= (int16_t)m_columns || row < 0 || row >= (int16_t)m_rows) {
+    return;
+  }
   auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
   if (bitmap_item != m_id_to_bitmap_map.end()) {
-    auto row_item = m_row_to_col_map.find(row);
-    if (row_item != m_row_to_col_map.end()) {
-      auto cb_map = row_item->second;
-      (*cb_map)[column] = bitmap_item->second;
-    } else {
-      auto cb_map = new DiTileColumnToBitmapMap();
-      m_row_to_col_map[row] = cb_map;
-      (*cb_map)[column] = bitmap_item->second;
+    get_writable_row(row)[column] = bitmap_item->second->get_index();
+  }
+}
+
+DiTileIndex* DiTileMap::get_writable_row(uint32_t row) {
+  auto tile_row = m_tile_rows[row];
+  if (!tile_row) {
+    tile_row = new DiTileIndex[m_columns];
+    memset(tile_row, 0, m_columns * sizeof(DiTileIndex));
+    m_tile_rows[row] = tile_row;
+  }
+  return tile_row;
+}
+
+void DiTileMap::set_tiles(int16_t column, int16_t row, DiTileBitmapID bm_id,
+                          int16_t columns, int16_t rows) {
+  auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+  int32_t col = column, rw = row, cols = columns, rws = rows;
+  if (bitmap_item == m_id_to_bitmap_map.end() ||
+      !clip_tile_region(m_columns, m_rows, col, rw, cols, rws)) {
+    return;
+  }
+  // The bitmap is found once for the whole rectangle.
+  auto index = bitmap_item->second->get_index();
+  while (rws--) {
+    auto tile_row = get_writable_row(rw++) + col;
+    for (int32_t i = 0; i < cols; i++) {
+      tile_row[i] = index;
     }
   }
 }
 
-void DiTileMap::unset_tile(int16_t column, int16_t row) {
-  auto row_item = m_row_to_col_map.find(row);
-  if (row_item != m_row_to_col_map.end()) {
-    auto cb_map = row_item->second;
-    auto bitmap_item = cb_map->find(column);
-    if (bitmap_item != cb_map->end()) {
-      cb_map->erase(bitmap_item);
-      if (!cb_map->size()) {
-        delete cb_map;
-        m_row_to_col_map.erase(row_item);
+void DiTileMap::unset_tiles(int16_t column, int16_t row, int16_t columns, int16_t rows) {
+  int32_t col = column, rw = row, cols = columns, rws = rows;
+  if (!clip_tile_region(m_columns, m_rows, col, rw, cols, rws)) {
+    return;
+  }
+  while (rws--) {
+    auto tile_row = m_tile_rows[rw++];
+    if (tile_row) {
+      memset(tile_row + col, 0, cols * sizeof(DiTileIndex));
+    }
+  }
+}
+
+void DiTileMap::set_tile_block(int16_t column, int16_t row, int16_t columns, int16_t rows,
+                                const uint8_t* bm_ids) {
+  // Neighboring cells often use the same bitmap, so the last one found is kept.
+  DiTileBitmapID last_id = 0;
+  DiTileIndex last_index = 0;
+  for (int32_t rw = row; rw < row + rows; rw++) {
+    for (int32_t col = column; col < column + columns; col++) {
+      DiTileBitmapID bm_id = bm_ids[0] | ((DiTileBitmapID)bm_ids[1] << 8);
+      bm_ids += 2;
+      if (col < 0 || col >= (int32_t)m_columns || rw < 0 || rw >= (int32_t)m_rows) {
+        continue;
+      }
+      if (!bm_id) {
+        unset_tile(col, rw);
+        continue;
       }
+      if (bm_id != last_id) {
+        auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+        if (bitmap_item == m_id_to_bitmap_map.end()) {
+          continue;
+        }
+        last_id = bm_id;
+        last_index = bitmap_item->second->get_index();
+      }
+      get_writable_row(rw)[col] = last_index;
     }
   }
 }
 
-DiTileBitmapID DiTileMap::get_tile(int16_t column, int16_t row) {
-  auto row_item = m_row_to_col_map.find(row);
-  if (row_item != m_row_to_col_map.end()) {
-    auto cb_map = row_item->second;
-    auto bitmap_item = cb_map->find(column);
-    if (bitmap_item != cb_map->end()) {
-      return bitmap_item->second->get_id();
+void DiTileMap::copy_tiles(int16_t src_column, int16_t src_row, int16_t columns, int16_t rows,
+                            int16_t dst_column, int16_t dst_row, bool move) {
+  int32_t sc = src_column, sr = src_row, dc = dst_column, dr = dst_row, cols = columns, rws = rows;
+  if (!clip_tile_copy(m_columns, m_rows, sc, sr, dc, dr, cols, rws)) {
+    return;
+  }
+
+  // Copy whole row spans, in the direction that reads each overlapping row before
+  // overwriting it. Within a row, memmove handles any overlap.
+  bool backward_rows = (dr > sr);
+  for (int32_t i = 0; i < rws; i++) {
+    int32_t r = (backward_rows ? rws - 1 - i : i);
+    auto src_tiles = m_tile_rows[sr + r];
+    if (src_tiles) {
+      memmove(get_writable_row(dr + r) + dc, src_tiles + sc, cols * sizeof(DiTileIndex));
+    } else if (m_tile_rows[dr + r]) {
+      memset(m_tile_rows[dr + r] + dc, 0, cols * sizeof(DiTileIndex));
     }
   }
+
+  if (move) {
+    for (int32_t r = 0; r < rws; r++) {
+      for (int32_t c = 0; c < cols; c++) {
+        int32_t col = sc + c;
+        int32_t rw = sr + r;
+        if (col < dc || col >= dc + cols || rw < dr || rw >= dr + rws) {
+          unset_tile(col, rw);
+        }
+      }
+    }
+  }
+}
+
+void DiTileMap::unset_tile(int16_t column, int16_t row) {
+  if (column < 0 || column >= (int16_t)m_columns || row < 0 || row >= (int16_t)m_rows) {
+    return;
+  }
+  auto tile_row = m_tile_rows[row];
+  if (tile_row) {
+    tile_row[column] = 0;
+  }
+}
+
+DiTileBitmapID DiTileMap::get_tile(int16_t column, int16_t row) {
+  if (column < 0 || column >= (int16_t)m_columns || row < 0 || row >= (int16_t)m_rows) {
+    return 0;
+  }
+  auto tile_row = m_tile_rows[row];
+  if (tile_row && tile_row[column]) {
+    return m_bitmaps[tile_row[column] & TILE_INDEX_MASK]->get_id();
+  }
   return 0;
 }
 
+void DiTileMap::free_world() {
+  if (m_world) {
+    heap_caps_free(m_world);
+    m_world = NULL;
+  }
+  m_world_columns = 0;
+  m_world_rows = 0;
+  m_window_valid = false;
+}
+
+void DiTileMap::set_world_size(uint32_t world_columns, uint32_t world_rows) {
+  free_world();
+  if (world_columns < m_columns || world_rows < m_rows) {
+    return;
+  }
+
+  // The byte count can exceed 32 bits (65535 x 65535 cells), so it is checked
+  // before anything is allocated.
+  uint64_t world_bytes = (uint64_t)world_columns * world_rows * sizeof(DiTileIndex);
+  if (world_bytes > (uint64_t)SIZE_MAX) {
+    return;
+  }
+  size_t bytes = (size_t)world_bytes;
+
+  // Fall back to internal RAM if there is no (or not enough) PSRAM.
+  m_world = (DiTileIndex*) heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM|MALLOC_CAP_8BIT);
+  if (!m_world) {
+    m_world = (DiTileIndex*) heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    if (!m_world) {
+      return;
+    }
+  }
+  memset(m_world, 0, bytes);
+  m_world_columns = world_columns;
+  m_world_rows = world_rows;
+  set_world_scroll_position(0, 0);
+}
+
+void DiTileMap::set_world_tile_block(int32_t column, int32_t row, int32_t columns, int32_t rows,
+                                      const uint8_t* bm_ids) {
+  if (!m_world) {
+    return;
+  }
+  // Neighboring cells often use the same bitmap, so the last one found is kept.
+  DiTileBitmapID last_id = 0;
+  DiTileIndex last_index = 0;
+  for (int32_t rw = row; rw < row + rows; rw++) {
+    for (int32_t col = column; col < column + columns; col++) {
+      DiTileBitmapID bm_id = bm_ids[0] | ((DiTileBitmapID)bm_ids[1] << 8);
+      bm_ids += 2;
+      if (col < 0 || col >= (int32_t)m_world_columns || rw < 0 || rw >= (int32_t)m_world_rows) {
+        continue;
+      }
+      DiTileIndex index = 0;
+      if (bm_id) {
+        if (bm_id != last_id) {
+          auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+          if (bitmap_item == m_id_to_bitmap_map.end()) {
+            continue;
+          }
+          last_id = bm_id;
+          last_index = bitmap_item->second->get_index();
+        }
+        index = last_index;
+      }
+      m_world[rw * m_world_columns + col] = index;
+
+      // A tile already in the window changes at once.
+      if (m_window_valid &&
+          col >= m_window_column && col < m_window_column + (int32_t)m_columns &&
+          rw >= m_window_row && rw < m_window_row + (int32_t)m_rows) {
+        get_writable_row(rw % m_rows)[col % m_columns] = index;
+      }
+    }
+  }
+}
+
+void DiTileMap::set_world_scroll_position(int32_t x, int32_t y) {
+  if (!m_world) {
+    return;
+  }
+  int32_t max_x = (int32_t)((m_world_columns - m_visible_columns) * m_tile_width);
+  int32_t max_y = (int32_t)((m_world_rows - m_visible_rows) * m_tile_height);
+  x = MAX(0, MIN(x, max_x));
+  y = MAX(0, MIN(y, max_y));
+
+  // The window is centered on the visible area, as far as the edges of the world allow.
+  int32_t column = x / (int32_t)m_tile_width - ((int32_t)m_columns - (int32_t)m_visible_columns) / 2;
+  int32_t row = y / (int32_t)m_tile_height - ((int32_t)m_rows - (int32_t)m_visible_rows) / 2;
+  m_wanted_column = MAX(0, MIN(column, (int32_t)(m_world_columns - m_columns)));
+  m_wanted_row = MAX(0, MIN(row, (int32_t)(m_world_rows - m_rows)));
+
+  // World cell (column, row) is kept in window cell (column % columns, row % rows), so the
+  // window is scrolled just as a map that wraps around.
+  m_scroll_x = x % m_width;
+  m_scroll_y = y % m_height;
+}
+
+void DiTileMap::load_world_row(int32_t world_row) {
+  // The world row is contiguous, but it wraps around within the window row.
+  auto tile_row = get_writable_row(world_row % m_rows);
+  auto src_tiles = m_world + world_row * m_world_columns + m_window_column;
+  uint32_t start = m_window_column % m_columns;
+  uint32_t count = m_columns - start;
+  memcpy(tile_row + start, src_tiles, count * sizeof(DiTileIndex));
+  memcpy(tile_row, src_tiles + count, start * sizeof(DiTileIndex));
+}
+
+void DiTileMap::load_world_column(int32_t world_column) {
+  auto src_tiles = m_world + m_window_row * m_world_columns + world_column;
+  uint32_t column = world_column % m_columns;
+  for (int32_t row = m_window_row; row < m_window_row + (int32_t)m_rows; row++) {
+    get_writable_row(row % m_rows)[column] = *src_tiles;
+    src_tiles += m_world_columns;
+  }
+}
+
+void DiTileMap::refill_window() {
+  if (!m_world) {
+    return;
+  }
+  int32_t delta_columns = m_wanted_column - m_window_column;
+  int32_t delta_rows = m_wanted_row - m_window_row;
+  if (!m_window_valid ||
+      delta_columns >= (int32_t)m_columns || delta_columns <= -(int32_t)m_columns ||
+      delta_rows >= (int32_t)m_rows || delta_rows <= -(int32_t)m_rows) {
+    // Nothing in the window can be kept.
+    m_window_column = m_wanted_column;
+    m_window_row = m_wanted_row;
+    for (int32_t row = m_window_row; row < m_window_row + (int32_t)m_rows; row++) {
+      load_world_row(row);
+    }
+    m_window_valid = true;
+    return;
+  }
+
+  // Each column or row that enters the window replaces the one that leaves it.
+  while (m_window_column < m_wanted_column) {
+    load_world_column(m_window_column + m_columns);
+    m_window_column++;
+  }
+  while (m_window_column > m_wanted_column) {
+    m_window_column--;
+    load_world_column(m_window_column);
+  }
+  while (m_window_row < m_wanted_row) {
+    load_world_row(m_window_row + m_rows);
+    m_window_row++;
+  }
+  while (m_window_row > m_wanted_row) {
+    m_window_row--;
+    load_world_row(m_window_row);
+  }
+}
+
+void DiTileMap::set_tile_flip(int16_t column, int16_t row, uint16_t flip) {
+  if (column < 0 || column >= (int16_t)m_columns || row < 0 || row >= (int16_t)m_rows) {
+    return;
+  }
+  auto tile_row = m_tile_rows[row];
+  if (tile_row && tile_row[column]) {
+    // The flip is kept with the tile index, so that one bitmap serves every orientation.
+    flip &= TILE_FLIP_MASK;
+    tile_row[column] = (tile_row[column] & TILE_INDEX_MASK) | flip;
+    if (flip) {
+      m_has_flipped_tiles = true;
+    }
+  }
+}
+
+void DiTileMap::set_tile_animation(DiTileBitmapID bm_id, const std::vector<DiTileBitmapID>& frame_ids,
+                          uint32_t frames_per_step) {
+  auto bitmap_item = m_id_to_bitmap_map.find(bm_id);
+  if (bitmap_item == m_id_to_bitmap_map.end()) {
+    return;
+  }
+  auto index = bitmap_item->second->get_index();
+
+  // Stop any existing animation of the tile, and show the tile itself again.
+  for (auto anim = m_animations.begin(); anim != m_animations.end(); ++anim) {
+    if (anim->m_index == index) {
+      m_animations.erase(anim);
+      break;
+    }
+  }
+  m_shown_bitmaps[index] = m_bitmaps[index];
+  m_bitmap_pixels[index] = m_bitmaps[index]->get_pixels();
+
+  DiTileAnimation anim;
+  for (auto frame_id = frame_ids.begin(); frame_id != frame_ids.end(); ++frame_id) {
+    auto frame_item = m_id_to_bitmap_map.find(*frame_id);
+    if (frame_item != m_id_to_bitmap_map.end()) {
+      anim.m_frames.push_back(frame_item->second->get_index());
+    }
+  }
+  if (anim.m_frames.size() < 2) {
+    return;
+  }
+  anim.m_index = index;
+  anim.m_frames_per_step = (frames_per_step ? frames_per_step : 1);
+  anim.m_countdown = anim.m_frames_per_step;
+  anim.m_frame = 0;
+  m_shown_bitmaps[index] = m_bitmaps[anim.m_frames[0]];
+  m_bitmap_pixels[index] = m_bitmaps[anim.m_frames[0]]->get_pixels();
+  m_animations.push_back(anim);
+}
+
+bool DiTileMap::animate() {
+  bool changed = false;
+  for (auto anim = m_animations.begin(); anim != m_animations.end(); ++anim) {
+    if (--anim->m_countdown) {
+      continue;
+    }
+    anim->m_countdown = anim->m_frames_per_step;
+    if (++anim->m_frame >= anim->m_frames.size()) {
+      anim->m_frame = 0;
+    }
+
+    // Only the table entry changes, so every cell using the tile changes at once.
+    auto bitmap = m_bitmaps[anim->m_frames[anim->m_frame]];
+    m_shown_bitmaps[anim->m_index] = bitmap;
+    m_bitmap_pixels[anim->m_index] = bitmap->get_pixels();
+    changed = true;
+  }
+  return changed;
+}
+
+void DiTileMap::set_scroll_position(int32_t x, int32_t y) {
+  x %= m_width;
+  if (x < 0) {
+    x += m_width;
+  }
+  y %= m_height;
+  if (y < 0) {
+    y += m_height;
+  }
+  m_scroll_x = x;
+  m_scroll_y = y;
+}
+
+void DiTileMap::set_line_table(uint32_t first_line, uint32_t num_lines, const uint8_t* entries) {
+  if (!num_lines) {
+    auto line_table = m_line_table;
+    m_line_table = NULL;
+    delete [] line_table;
+    return;
+  }
+
+  if (!m_line_table) {
+    auto line_table = new int32_t[ACT_LINES * 2];
+    memset(line_table, 0, ACT_LINES * 2 * sizeof(int32_t));
+    m_line_table = line_table;
+  }
+
+  // The offsets are kept within the map size, so that painting needs only simple wrapping.
+  while (num_lines-- && first_line < ACT_LINES) {
+    int32_t x = (int16_t)(entries[0] | ((uint16_t)entries[1] << 8));
+    int32_t y = (int16_t)(entries[2] | ((uint16_t)entries[3] << 8));
+    x %= m_width;
+    if (x < 0) {
+      x += m_width;
+    }
+    y %= m_height;
+    if (y < 0) {
+      y += m_height;
+    }
+    m_line_table[first_line * 2] = x;
+    m_line_table[first_line * 2 + 1] = y;
+    first_line++;
+    entries += 4;
+  }
+}
+
+void IRAM_ATTR DiTileMap::paint_tile_pixels(uint8_t* line_bytes, int32_t x, DiTileIndex index,
+                  uint32_t y_offset_within_tile, uint32_t x_offset_within_tile, uint32_t width) {
+  auto flip = index & TILE_FLIP_MASK;
+  index &= TILE_INDEX_MASK;
+  if (index) {
+    if (flip & TILE_FLIP_V) {
+      y_offset_within_tile = m_tile_height - 1 - y_offset_within_tile;
+    }
+    // The first copy of the bitmap pixels is not shifted.
+    auto src_bytes = (uint8_t*)(m_pixel_table[index] + y_offset_within_tile * m_words_per_line);
+    bool blended = (m_flags & PRIM_FLAGS_BLENDED) != 0;
+    if (!flip && !blended) {
+      while (width--) {
+        line_bytes[FIX_INDEX(x)] = src_bytes[FIX_INDEX(x_offset_within_tile)];
+        x++;
+        x_offset_within_tile++;
+      }
+      return;
+    }
+
+    // A flipped or blended tile is drawn as the tile bitmap code would draw it.
+    // As in that code, only a blended map skips transparent pixels.
+    int32_t col = x_offset_within_tile;
+    int32_t step = 1;
+    if (flip & TILE_FLIP_H) {
+      col = m_tile_width - 1 - x_offset_within_tile;
+      step = -1;
+    }
+    auto bitmap = m_shown_bitmaps[index];
+    auto transparent_color = bitmap->get_transparent_color();
+    while (width--) {
+      uint8_t color = src_bytes[FIX_INDEX(col)];
+      if (!blended || color != transparent_color) {
+        if (blended && (color & 0xC0)) {
+          line_bytes[FIX_INDEX(x)] = blend_pixel(line_bytes[FIX_INDEX(x)], color);
+        } else {
+          line_bytes[FIX_INDEX(x)] = color;
+        }
+      }
+      x++;
+      col += step;
+    }
+  }
+}
+
+void IRAM_ATTR DiTileMap::paint_flipped_tiles(uint8_t* line_bytes, int32_t x, const DiTileIndex* tile_row,
+                                     uint32_t num_tiles, uint32_t y_offset_within_tile) {
+  while (num_tiles--) {
+    auto index = *tile_row++;
+    if (index & TILE_FLIP_MASK) {
+      paint_tile_pixels(line_bytes, x, index, y_offset_within_tile, 0, m_tile_width);
+    }
+    x += m_tile_width;
+  }
+}
+
 void IRAM_ATTR DiTileMap::paint(volatile uint32_t* p_scan_line, uint32_t line_index) {
   auto y_offset_within_tile_map = (int32_t)line_index - m_abs_y;
-  if (y_offset_within_tile_map >= 0 && y_offset_within_tile_map < m_height) {
-    auto row = y_offset_within_tile_map / (int32_t)m_tile_height;
-    auto row_item = m_row_to_col_map.find((uint16_t)row);
-    if (row_item != m_row_to_col_map.end()) {
-      auto cb_map = row_item->second;
-      auto start_x_offset_within_tile_map = m_draw_x - m_abs_x;
-      auto start_column = (start_x_offset_within_tile_map + m_tile_width - 1) / m_tile_width;
-      auto end_x_offset_within_tile_map = m_draw_x_extent - m_abs_x;
-      auto end_column = end_x_offset_within_tile_map / m_tile_width;
-      auto fcn_index = m_draw_x & 0x3;
-      uint32_t draw_x = m_draw_x & 0xFFFFFFFC;
-      auto y_offset_within_tile = y_offset_within_tile_map % (int32_t)m_tile_height;
-      auto src_pixels_offset = fcn_index * m_bytes_per_position + y_offset_within_tile * m_bytes_per_line;
-      for (auto column = start_column; column < end_column; column++) {
-        auto bitmap_item = cb_map->find(column);
-        if (bitmap_item != cb_map->end()) {
-          auto bitmap = bitmap_item->second;
-          bitmap->paint(this, fcn_index, p_scan_line, y_offset_within_tile, draw_x, src_pixels_offset);
-        }
-        draw_x += m_tile_width;
+  if (y_offset_within_tile_map < 0 || y_offset_within_tile_map >= m_height) {
+    return;
+  }
+  int32_t line_x_offset = 0;
+  auto line_table = m_line_table;
+  if (line_table && y_offset_within_tile_map < ACT_LINES) {
+    line_x_offset = line_table[y_offset_within_tile_map * 2];
+    y_offset_within_tile_map += line_table[y_offset_within_tile_map * 2 + 1];
+  }
+  y_offset_within_tile_map += m_scroll_y;
+  while (y_offset_within_tile_map >= m_height) {
+    y_offset_within_tile_map -= m_height;
+  }
+  auto row = y_offset_within_tile_map / (int32_t)m_tile_height;
+  auto tile_row = m_tile_rows[row];
+  if (!tile_row) {
+    return;
+  }
+  uint32_t y_offset_within_tile = y_offset_within_tile_map - row * (int32_t)m_tile_height;
+
+  int32_t x = m_draw_x;
+  int32_t x_extent = m_draw_x_extent;
+  int32_t x_offset_within_tile_map = x - m_abs_x + m_scroll_x + line_x_offset;
+  while (x_offset_within_tile_map >= m_width) {
+    x_offset_within_tile_map -= m_width;
+  }
+  uint32_t column = x_offset_within_tile_map / m_tile_width;
+  uint32_t x_offset_within_tile = x_offset_within_tile_map - column * m_tile_width;
+
+  if (m_flags & PRIM_FLAGS_BLENDED) {
+    // Whole tiles are drawn using the code in each tile bitmap, and the tiles
+    // cut off by the edges are blended a pixel at a time.
+    if (x_offset_within_tile) {
+      uint32_t width = MIN(m_tile_width - x_offset_within_tile, (uint32_t)(x_extent - x));
+      paint_tile_pixels((uint8_t*)p_scan_line, x, tile_row[column], y_offset_within_tile,
+                        x_offset_within_tile, width);
+      x += width;
+      if (++column >= m_columns) {
+        column = 0;
+      }
+    }
+    auto bitmaps = m_shown_bitmaps.data();
+    while (x + (int32_t)m_tile_width <= x_extent) {
+      auto index = tile_row[column];
+      if (index & TILE_FLIP_MASK) {
+        paint_tile_pixels((uint8_t*)p_scan_line, x, index, y_offset_within_tile, 0, m_tile_width);
+      } else if (index) {
+        auto fcn_index = x & 3;
+        auto src_pixels_offset = fcn_index * m_bytes_per_position + y_offset_within_tile * m_bytes_per_line;
+        bitmaps[index]->paint(this, fcn_index, p_scan_line, y_offset_within_tile, x & 0xFFFFFFFC, src_pixels_offset);
+      }
+      x += m_tile_width;
+      if (++column >= m_columns) {
+        column = 0;
+      }
+    }
+    if (x < x_extent) {
+      paint_tile_pixels((uint8_t*)p_scan_line, x, tile_row[column], y_offset_within_tile, 0, x_extent - x);
+    }
+    return;
+  }
+
+  auto line_bytes = (uint8_t*)p_scan_line;
+
+  // Draw the visible part of a tile cut off by the left edge.
+  if (x_offset_within_tile) {
+    uint32_t width = MIN(m_tile_width - x_offset_within_tile, (uint32_t)(x_extent - x));
+    paint_tile_pixels(line_bytes, x, tile_row[column], y_offset_within_tile, x_offset_within_tile, width);
+    x += width;
+    if (++column >= m_columns) {
+      column = 0;
+    }
+  }
+
+  // Draw the whole tiles, in runs that stop at the right side of the map (which wraps around).
+  uint32_t num_tiles = (x_extent - x) / (int32_t)m_tile_width;
+  uint32_t pos = x & 3;
+  bool use_code = m_row_fcn[pos].get_code_size() != 0;
+  while (num_tiles) {
+    uint32_t run = MIN(num_tiles, m_columns - column);
+    if (use_code) {
+      auto src_pixels_offset = pos * m_bytes_per_position + y_offset_within_tile * m_bytes_per_line;
+      m_row_fcn[pos].call_a5_a6(this, (volatile uint32_t*)(line_bytes + x - pos), run,
+        (uint32_t)(tile_row + column), src_pixels_offset);
+      if (m_has_flipped_tiles) {
+        paint_flipped_tiles(line_bytes, x, tile_row + column, run, y_offset_within_tile);
       }
+      x += run * m_tile_width;
+    } else {
+      // There is no code for this pixel offset (e.g., without PRIM_FLAG_H_SCROLL_1).
+      for (uint32_t i = 0; i < run; i++) {
+        paint_tile_pixels(line_bytes, x, tile_row[column + i], y_offset_within_tile, 0, m_tile_width);
+        x += m_tile_width;
+      }
+    }
+    num_tiles -= run;
+    column += run;
+    if (column >= m_columns) {
+      column = 0;
     }
   }
+
+  // Draw the visible part of a tile cut off by the right edge.
+  if (x < x_extent) {
+    paint_tile_pixels(line_bytes, x, tile_row[column], y_offset_within_tile, 0, x_extent - x);
+  }
 }
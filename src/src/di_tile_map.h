@@ -32,6 +32,7 @@
 #include "di_code.h"
 #include "di_tile_bitmap.h"
 #include <map>
+#include <vector>
 
 typedef uint32_t DiRowColumn;
 
@@ -40,8 +41,23 @@ typedef uint32_t DiRowColumn;
 typedef std::map<DiTileBitmapID, DiPaintableTileBitmap*> DiTileIdToBitmapMap;
 #endif
 
-typedef std::map<uint16_t, DiPaintableTileBitmap*> DiTileColumnToBitmapMap;
-typedef std::map<uint16_t, DiTileColumnToBitmapMap*> DiTileRowToColumnMap;
+// Index of a tile bitmap within the bitmap table of a tile map (0 means no tile).
+// The upper bits of a cell's tile index tell how to flip the tile in that cell.
+typedef uint16_t DiTileIndex;
+
+#define TILE_FLIP_H       0x8000  // mirror the tile left-to-right
+#define TILE_FLIP_V       0x4000  // mirror the tile top-to-bottom
+#define TILE_FLIP_MASK    (TILE_FLIP_H|TILE_FLIP_V)
+#define TILE_INDEX_MASK   0x3FFF  // tile index without the flip bits
+
+// An animated tile, which shows a sequence of tile bitmaps in every cell that uses the tile.
+typedef struct {
+  DiTileIndex   m_index;            // tile index that shows the frames
+  uint16_t      m_frames_per_step;  // number of video frames per animation step
+  uint16_t      m_countdown;        // video frames left before the next step
+  uint16_t      m_frame;            // index of the frame being shown
+  std::vector<DiTileIndex> m_frames; // tile indexes of the bitmaps to show, in order
+} DiTileAnimation;
 
 class DiTileMap: public DiPrimitive {
   public:
@@ -60,6 +76,7 @@ class DiTileMap: public DiPrimitive {
   virtual void IRAM_ATTR generate_instructions();
 
   // Create the array of pixels for the tile bitmap.
+  // Returns NULL when the map already holds TILE_INDEX_MASK bitmaps.
   DiTileBitmap* create_bitmap(DiTileBitmapID bm_id);
 
   // Save the pixel value of a particular pixel in a specific tile bitmap. A tile bitmap
@@ -72,21 +89,130 @@ class DiTileMap: public DiPrimitive {
   // Unset the bitmap ID to use to draw a tile at a specific row and column.
   void unset_tile(int16_t column, int16_t row);
 
+  // Set the bitmap ID to use to fill a rectangle of tiles. Cells outside the map are ignored.
+  void set_tiles(int16_t column, int16_t row, DiTileBitmapID bm_id, int16_t columns, int16_t rows);
+
+  // Unset the bitmap IDs to remove a rectangle of tiles. Cells outside the map are ignored.
+  void unset_tiles(int16_t column, int16_t row, int16_t columns, int16_t rows);
+
+  // Set the bitmap IDs of a rectangle of tiles, from 16-bit IDs (low byte first) in row-major
+  // order. An ID of 0 removes the tile, and an unknown ID leaves the cell unchanged.
+  void set_tile_block(int16_t column, int16_t row, int16_t columns, int16_t rows, const uint8_t* bm_ids);
+
+  // Copy a rectangle of tiles (or the lack of them), including any flips, to another position,
+  // as if through a temporary copy, so the rectangles may overlap. When moving, the source
+  // cells that are not overwritten are emptied.
+  void copy_tiles(int16_t src_column, int16_t src_row, int16_t columns, int16_t rows,
+                  int16_t dst_column, int16_t dst_row, bool move);
+
+  // Set how to flip the tile at a specific row and column (TILE_FLIP_H and/or TILE_FLIP_V).
+  // Setting the tile again removes any flip.
+  void set_tile_flip(int16_t column, int16_t row, uint16_t flip);
+
   // Get the bitmap ID presently at the given row and column.
   DiTileBitmapID get_tile(int16_t column, int16_t row);
 
+  // Set the scroll position, which is the pixel within the whole map that appears at the
+  // upper-left corner of the tile map primitive. The map wraps around in both directions.
+  // This does not change the geometry of the primitive, so it is cheap to do every frame.
+  void set_scroll_position(int32_t x, int32_t y);
+
+  // Set entries in the line table, which holds an extra horizontal offset and an extra
+  // vertical offset (source row remap) for each screen line of the tile map, starting at its
+  // top. The offsets are added to the scroll position as each line is painted, and wrap around
+  // the map. Each entry is a pair of 16-bit values (X offset, then Y offset). Setting 0 entries
+  // removes the line table.
+  void set_line_table(uint32_t first_line, uint32_t num_lines, const uint8_t* entries);
+
+  // Make the tile map a window onto a larger world of the given size (in tiles). The tile
+  // indexes of the whole world are kept in PSRAM (if available), while the cells of the tile
+  // map hold only the part of the world around the visible area, which is refilled during
+  // blanking as the world scroll position changes. The tile map should have at least one
+  // more column and row than fit on the screen, plus a margin on each side. Using a size
+  // smaller than the tile map removes the world.
+  void set_world_size(uint32_t world_columns, uint32_t world_rows);
+
+  // Set the bitmap IDs of a rectangle of world tiles, as with set_tile_block().
+  void set_world_tile_block(int32_t column, int32_t row, int32_t columns, int32_t rows, const uint8_t* bm_ids);
+
+  // Set the world scroll position, which is the pixel within the world that appears at the
+  // upper-left corner of the tile map primitive. The position is kept within the world.
+  void set_world_scroll_position(int32_t x, int32_t y);
+
+  // Load the world tiles that have come into the window (the cells of the tile map) since
+  // the last time, one row or column at a time. This is done during vertical blanking.
+  void refill_window();
+
+  // Determine whether the tile map is a window onto a world.
+  inline bool is_world() { return m_world != NULL; }
+
+  // Animate a tile, so that every cell using the given bitmap ID shows the given bitmaps
+  // in turn, changing once per the given number of video frames. The cells themselves do
+  // not change. Using fewer than 2 frames stops the animation, and shows the tile again.
+  void set_tile_animation(DiTileBitmapID bm_id, const std::vector<DiTileBitmapID>& frame_ids,
+                          uint32_t frames_per_step);
+
+  // Advance the tile animations by one video frame. Returns true if any tile changed.
+  bool animate();
+
+  // Determine whether any tiles are animated.
+  inline bool is_animated() { return !m_animations.empty(); }
+
   virtual void IRAM_ATTR paint(volatile uint32_t* p_scan_line, uint32_t line_index);
 
   protected:
+  // Get the tile indexes of a row, allocating them if the row has no tiles yet.
+  DiTileIndex* get_writable_row(uint32_t row);
+
+  // Copy one row of world tiles, across the window columns, into the window.
+  void load_world_row(int32_t world_row);
+
+  // Copy one column of world tiles, across the window rows, into the window.
+  void load_world_column(int32_t world_column);
+
+  // Free the world tile indexes.
+  void free_world();
+
+  // Assemble the row painters, which copy a number of whole, opaque tiles on one line.
+  void generate_row_painters();
+
+  // Draw the flipped tiles in a run of whole tiles, which the row painters skip.
+  void IRAM_ATTR paint_flipped_tiles(uint8_t* line_bytes, int32_t x, const DiTileIndex* tile_row,
+                                     uint32_t num_tiles, uint32_t y_offset_within_tile);
+
+  // Copy some pixels of one tile, one byte at a time (used at the edges of a line, and for
+  // flipped tiles).
+  void IRAM_ATTR paint_tile_pixels(uint8_t* line_bytes, int32_t x, DiTileIndex index,
+                                  uint32_t y_offset_within_tile, uint32_t x_offset_within_tile, uint32_t width);
+
   uint32_t  m_columns;              // number of columns (cells in each row)
   uint32_t  m_rows;                 // number of rows (cells in each column)
   uint32_t  m_bytes_per_line;       // number of 1-pixel bytes in each bitmap line
   uint32_t  m_bytes_per_position;   // number of 1-pixel bytes in each bitmap position
+  uint32_t  m_words_per_line;       // number of 4-pixel words in each bitmap line
+  int32_t   m_scroll_x;             // pixel column of the map shown at the left edge
+  int32_t   m_scroll_y;             // pixel row of the map shown at the top edge
+  int32_t*  m_line_table;           // X and Y offsets added per screen line (NULL if none)
   uint32_t  m_visible_columns;      // number of columns that fit on the screen
   uint32_t  m_visible_rows;         // number of rows that fit on the screen
   uint32_t  m_tile_width;           // width of 1 tile in pixels
   uint32_t  m_tile_height;          // height of 1 tile in pixels
   uint8_t   m_transparent_color;    // value indicating not to draw the pixel
+  bool      m_has_flipped_tiles;    // whether any cell has ever been flipped
   DiTileIdToBitmapMap m_id_to_bitmap_map; // caches bitmaps based on bitmap ID
-  DiTileRowToColumnMap m_row_to_col_map;  // refers to bitmaps based on row & column
+  std::vector<DiPaintableTileBitmap*> m_bitmaps; // bitmap table, indexed by tile index
+  DiTileIndex** m_tile_rows;        // tile indexes for each row; a row without tiles is not allocated
+  std::vector<DiPaintableTileBitmap*> m_shown_bitmaps; // bitmap shown for each tile index (may be animated)
+  std::vector<uint32_t*> m_bitmap_pixels; // pixels shown for each tile index (may be animated)
+  std::vector<DiTileAnimation> m_animations; // animated tiles
+  uint32_t** m_pixel_table;         // start of m_bitmap_pixels (read by the row painters)
+  DiTileIndex* m_world;             // tile indexes of the whole world (NULL if none)
+  uint32_t  m_world_columns;        // number of columns in the world
+  uint32_t  m_world_rows;           // number of rows in the world
+  int32_t   m_window_column;        // world column held in the first window column
+  int32_t   m_window_row;           // world row held in the first window row
+  int32_t   m_wanted_column;        // world column that the window should start at
+  int32_t   m_wanted_row;           // world row that the window should start at
+  bool      m_window_valid;         // whether the window holds any world tiles yet
+  EspFunction m_row_fcn[4];         // dynamic code to copy whole tiles, per pixel offset
 };
@@ -3472,5 +3472,6 @@ Mesh mesh_teapot = {
     .positions = positions,
     .pos_indices = indexes,
     .tex_indices = tex_indexes,
-    .textCoord = &tex_coords
+    .textCoord = &tex_coords,
+    .positions_count = teapot_vertices
 };
@@ -0,0 +1,134 @@
+#include "fixed.h"
+
+// 2^31 / (1 + i/256), for i = 0 to 256
+static const uint32_t reciprocalTable[257] = {
+    0x80000000, 0x7F807F80, 0x7F01FC08, 0x7E8472A8, 0x7E07E07E, 0x7D8C42B3,
+    0x7D119679, 0x7C97D911, 0x7C1F07C2, 0x7BA71FE1, 0x7B301ECC, 0x7ABA01EB,
+    0x7A44C6B0, 0x79D06A96, 0x795CEB24, 0x78EA45E7, 0x78787878, 0x78078078,
+    0x77975B90, 0x77280773, 0x76B981DB, 0x764BC88C, 0x75DED953, 0x7572B202,
+    0x75075075, 0x749CB290, 0x7432D63E, 0x73C9B971, 0x73615A24, 0x72F9B658,
+    0x7292CC15, 0x722C996C, 0x71C71C72, 0x71625344, 0x70FE3C07, 0x709AD4E5,
+    0x70381C0E, 0x6FD60FBA, 0x6F74AE26, 0x6F13F596, 0x6EB3E453, 0x6E5478AC,
+    0x6DF5B0F7, 0x6D978B8F, 0x6D3A06D4, 0x6CDD212B, 0x6C80D902, 0x6C252CC7,
+    0x6BCA1AF3, 0x6B6FA1FE, 0x6B15C06B, 0x6ABC74BE, 0x6A63BD82, 0x6A0B9945,
+    0x69B4069B, 0x695D041E, 0x69069069, 0x68B0AA1F, 0x685B4FE6, 0x68068068,
+    0x67B23A54, 0x675E7C5E, 0x670B453C, 0x66B893A9, 0x66666666, 0x6614BC36,
+    0x65C393E0, 0x6572EC30, 0x6522C3F3, 0x64D319FE, 0x6483ED27, 0x64353C48,
+    0x63E7063E, 0x639949EC, 0x634C0635, 0x62FF3A02, 0x62B2E43E, 0x626703D8,
+    0x621B97C3, 0x61D09EF3, 0x61861862, 0x613C030A, 0x60F25DEB, 0x60A92806,
+    0x60606060, 0x60180602, 0x5FD017F4, 0x5F889545, 0x5F417D06, 0x5EFACE49,
+    0x5EB48824, 0x5E6EA9AF, 0x5E293206, 0x5DE42046, 0x5D9F7391, 0x5D5B2B08,
+    0x5D1745D1, 0x5CD3C315, 0x5C90A1FD, 0x5C4DE1B6, 0x5C0B8170, 0x5BC9805C,
+    0x5B87DDAD, 0x5B46989A, 0x5B05B05B, 0x5AC5242B, 0x5A84F345, 0x5A451CEA,
+    0x5A05A05A, 0x59C67CD8, 0x5987B1A9, 0x59493E15, 0x590B2164, 0x58CD5AE2,
+    0x588FE9DC, 0x5852CDA1, 0x58160581, 0x57D990D1, 0x579D6EE3, 0x57619F10,
+    0x572620AE, 0x56EAF319, 0x56B015AC, 0x567587C5, 0x563B48C2, 0x56015805,
+    0x55C7B4F1, 0x558E5EEA, 0x55555555, 0x551C979B, 0x54E42524, 0x54ABFD5B,
+    0x54741FAC, 0x543C8B84, 0x54054054, 0x53CE3D8B, 0x5397829D, 0x53610EFB,
+    0x532AE21D, 0x52F4FB77, 0x52BF5A81, 0x5289FEB6, 0x5254E78F, 0x52201488,
+    0x51EB851F, 0x51B738D1, 0x51832F20, 0x514F678B, 0x511BE196, 0x50E89CC3,
+    0x50B59897, 0x5082D499, 0x50505050, 0x501E0B44, 0x4FEC04FF, 0x4FBA3D0B,
+    0x4F88B2F4, 0x4F576647, 0x4F265692, 0x4EF58365, 0x4EC4EC4F, 0x4E9490E2,
+    0x4E6470B0, 0x4E348B4E, 0x4E04E04E, 0x4DD56F47, 0x4DA637CF, 0x4D77397E,
+    0x4D4873ED, 0x4D19E6B4, 0x4CEB916D, 0x4CBD73B6, 0x4C8F8D29, 0x4C61DD64,
+    0x4C346405, 0x4C0720AB, 0x4BDA12F7, 0x4BAD3A88, 0x4B809701, 0x4B542805,
+    0x4B27ED36, 0x4AFBE639, 0x4AD012B4, 0x4AA4724C, 0x4A7904A8, 0x4A4DC96F,
+    0x4A22C04A, 0x49F7E8E3, 0x49CD42E2, 0x49A2CDF3, 0x497889C2, 0x494E75FA,
+    0x49249249, 0x48FADE5C, 0x48D159E2, 0x48A8048B, 0x487EDE05, 0x4855E601,
+    0x482D1C32, 0x48048048, 0x47DC11F7, 0x47B3D0F2, 0x478BBCED, 0x4763D59D,
+    0x473C1AB7, 0x47148BF0, 0x46ED2901, 0x46C5F1A0, 0x469EE584, 0x46780468,
+    0x46514E02, 0x462AC20E, 0x46046046, 0x45DE2864, 0x45B81A25, 0x45923544,
+    0x456C797E, 0x4546E690, 0x45217C38, 0x44FC3A35, 0x44D72045, 0x44B22E28,
+    0x448D639D, 0x4468C067, 0x44444444, 0x441FEEF8, 0x43FBC044, 0x43D7B7EB,
+    0x43B3D5B0, 0x43901956, 0x436C82A2, 0x43491159, 0x4325C53F, 0x43029E1A,
+    0x42DF9BB1, 0x42BCBDC9, 0x429A042A, 0x42776E9B, 0x4254FCE4, 0x4232AECE,
+    0x42108421, 0x41EE7CA7, 0x41CC9829, 0x41AAD672, 0x4189374C, 0x4167BA82,
+    0x41465FDF, 0x41252730, 0x41041041, 0x40E31ADE, 0x40C246D4, 0x40A193F2,
+    0x40810204, 0x406090D9, 0x40404040, 0x40201008, 0x40000000
+};
+
+// Returns 2^62 / norm, where norm has bit 31 set (so the result is from 2^30 to 2^31)
+static uint32_t reciprocalMantissa(uint32_t norm) {
+    uint32_t idx = (norm >> 23) & 0xFF;
+    uint32_t frac = (norm >> 7) & 0xFFFF;
+    return reciprocalTable[idx] -
+        (uint32_t)(((uint64_t)(reciprocalTable[idx] - reciprocalTable[idx + 1]) * frac) >> 16);
+}
+
+Fix16 fix16Reciprocal(Fix16 v) {
+    uint32_t u = v < 0 ? (uint32_t)(-(int64_t)v) : (uint32_t)v;
+    if (u <= 2)
+        return v < 0 ? -FIX16_MAX : FIX16_MAX;
+
+    // 1/v = 2^(lz+1) / mantissa, and r is 2^31 / mantissa
+    int lz = __builtin_clz(u);
+    uint32_t r = reciprocalMantissa(u << lz);
+    int shift = 30 - lz;
+    if (shift > 0)
+        r = (r + (1u << (shift - 1))) >> shift;
+    return v < 0 ? -(Fix16)r : (Fix16)r;
+}
+
+int64_t fixMulDivShift(int64_t num, int32_t den, int shift) {
+    if (num == 0 || den == 0)
+        return 0;
+    int negative = (num < 0) != (den < 0);
+    uint64_t un = num < 0 ? (uint64_t)0 - (uint64_t)num : (uint64_t)num;
+    uint32_t ud = den < 0 ? (uint32_t)0 - (uint32_t)den : (uint32_t)den;
+
+    // den = norm / 2^lz, so 1/den = r * 2^(lz-62)
+    int lz = __builtin_clz(ud);
+    uint64_t r = reciprocalMantissa(ud << lz);
+
+    // Keep the top 31 bits of the numerator, so the product fits in 62 bits
+    int bits = 64 - __builtin_clzll(un);
+    int k = bits > 31 ? bits - 31 : 0;
+    uint64_t product = (un >> k) * r;
+
+    int e = k + shift + lz - 62;
+    uint64_t result;
+    if (e >= 0)
+        result = product << e;
+    else if (e > -64)
+        result = product >> -e;
+    else
+        result = 0;
+    return negative ? -(int64_t)result : (int64_t)result;
+}
+
+uint32_t fixSqrt64(uint64_t v) {
+    uint64_t res = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= res + bit) {
+            v -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)res;
+}
+
+Vec4x vec4xFromVec3f(Vec3f * v) {
+    return (Vec4x){fix16FromFloat(v->x), fix16FromFloat(v->y), fix16FromFloat(v->z), FIX16_ONE};
+}
+
+Mat4x mat4xFromMat4(Mat4 * m) {
+    Mat4x out;
+    for (int i = 0; i < 16; i++)
+        out.elements[i] = fix16FromFloat(m->elements[i]);
+    return out;
+}
+
+Vec4x mat4xMultiplyVec4(Vec4x * v, Mat4x * t) {
+    const Fix16 * e = t->elements;
+    int64_t a = (int64_t)v->x * e[0] + (int64_t)v->y * e[1] + (int64_t)v->z * e[2] + ((int64_t)e[3] << 16);
+    int64_t b = (int64_t)v->x * e[4] + (int64_t)v->y * e[5] + (int64_t)v->z * e[6] + ((int64_t)e[7] << 16);
+    int64_t c = (int64_t)v->x * e[8] + (int64_t)v->y * e[9] + (int64_t)v->z * e[10] + ((int64_t)e[11] << 16);
+    int64_t d = (int64_t)v->x * e[12] + (int64_t)v->y * e[13] + (int64_t)v->z * e[14] + ((int64_t)e[15] << 16);
+    return (Vec4x){fix16Saturate(a >> 16), fix16Saturate(b >> 16), fix16Saturate(c >> 16), fix16Saturate(d >> 16)};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "mat4.h"
+#include "vec3.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fix16 is a signed Q16.16 fixed point number (16 integer bits, 16 fraction bits)
+ */
+typedef int32_t Fix16;
+
+#define FIX16_ONE ((Fix16)0x00010000)
+#define FIX16_MAX ((Fix16)0x7FFFFFFF)
+
+/**
+ * @brief Converts a floating point constant to Q16.16, at compile time
+ */
+#define FIX16_CONST(f) ((Fix16)((f) * 65536.0 + ((f) >= 0 ? 0.5 : -0.5)))
+
+typedef struct Vec4x {
+    Fix16 x;
+    Fix16 y;
+    Fix16 z;
+    Fix16 w;
+} Vec4x;
+
+typedef struct Mat4x {
+    Fix16 elements[16];
+} Mat4x;
+
+static inline Fix16 fix16Saturate(int64_t v) {
+    if (v > FIX16_MAX)
+        return FIX16_MAX;
+    if (v < -FIX16_MAX)
+        return -FIX16_MAX;
+    return (Fix16)v;
+}
+
+static inline Fix16 fix16Clamp(Fix16 v, Fix16 limit) {
+    return v > limit ? limit : (v < -limit ? -limit : v);
+}
+
+static inline Fix16 fix16FromFloat(float f) {
+    return fix16Saturate((int64_t)(f * 65536.0f + (f >= 0 ? 0.5f : -0.5f)));
+}
+
+static inline float fix16ToFloat(Fix16 v) {
+    return (float)v / 65536.0f;
+}
+
+static inline Fix16 fix16Mul(Fix16 a, Fix16 b) {
+    return fix16Saturate(((int64_t)a * b) >> 16);
+}
+
+/**
+ * @brief Returns 1/v, using a 257-entry table with linear interpolation (relative error about 4e-6)
+ */
+Fix16 fix16Reciprocal(Fix16 v);
+
+/**
+ * @brief Returns (num << shift) / den, using the same table instead of dividing (relative error about 4e-6)
+ */
+int64_t fixMulDivShift(int64_t num, int32_t den, int shift);
+
+/**
+ * @brief Returns the integer square root of a 64-bit value
+ */
+uint32_t fixSqrt64(uint64_t v);
+
+Vec4x vec4xFromVec3f(Vec3f * v);
+
+Mat4x mat4xFromMat4(Mat4 * m);
+
+/**
+ * @brief Same as mat4MultiplyVec4, including treating the W of the vector as 1
+ */
+Vec4x mat4xMultiplyVec4(Vec4x * v, Mat4x * t);
+
+#ifdef __cplusplus
+}
+#endif
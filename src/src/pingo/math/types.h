@@ -10,4 +10,10 @@ typedef int I_TYPE;
  */
 typedef float F_TYPE;
 
-
+/**
+ * @brief Selects the arithmetic used to transform and rasterize objects [PINGO_FLOAT | PINGO_FIXED]
+ * PINGO_FIXED uses Q16.16 transforms, a reciprocal table for the perspective divide, and integer interpolation
+ */
+#if !defined(PINGO_FLOAT) && !defined(PINGO_FIXED)
+#define PINGO_FLOAT
+#endif
@@ -8,6 +8,14 @@ void depth_write (PingoDepth * d, int idx, float value) {
 bool depth_check(PingoDepth * d, int idx, float value){
     return (uint32_t)(value * (float)UINT32_MAX) < d[idx].d;
 }
+
+void depth_write_fixed (PingoDepth * d, int idx, uint32_t value) {
+    d[idx].d = value;
+}
+
+bool depth_check_fixed(PingoDepth * d, int idx, uint32_t value){
+    return value < d[idx].d;
+}
 #endif
 
 #ifdef ZBUFFER16
@@ -18,6 +26,14 @@ void depth_write (PingoDepth * d, int idx, float value) {
 bool depth_check(PingoDepth * d, int idx, float value){
     return (uint16_t)(value * UINT16_MAX) < d[idx].d;
 }
+
+void depth_write_fixed (PingoDepth * d, int idx, uint32_t value) {
+    d[idx].d = (uint16_t)(value >> 16);
+}
+
+bool depth_check_fixed(PingoDepth * d, int idx, uint32_t value){
+    return (uint16_t)(value >> 16) < d[idx].d;
+}
 #endif
 
 #ifdef ZBUFFER8
@@ -28,5 +44,13 @@ void depth_write (PingoDepth * d, int idx, float value) {
 bool depth_check(PingoDepth * d, int idx, float value){
     return (uint8_t)(value * UINT8_MAX) > d[idx].d;
 }
+
+void depth_write_fixed (PingoDepth * d, int idx, uint32_t value) {
+    d[idx].d = (uint8_t)(value >> 24);
+}
+
+bool depth_check_fixed(PingoDepth * d, int idx, uint32_t value){
+    return (uint8_t)(value >> 24) > d[idx].d;
+}
 #endif
 
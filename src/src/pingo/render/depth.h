@@ -26,3 +26,7 @@ typedef struct Depth {
 void depth_write(PingoDepth * d, int idx, float value);
 bool depth_check(PingoDepth * d, int idx, float value);
 
+// Same as above, with the value in 0.32 fixed point (0 to UINT32_MAX for 0.0 to 1.0)
+void depth_write_fixed(PingoDepth * d, int idx, uint32_t value);
+bool depth_check_fixed(PingoDepth * d, int idx, uint32_t value);
+
@@ -1,10 +1,14 @@
 #include "mesh.h"
-
-
-
-
-
-
-
-
-
+#include <math.h>
+
+void meshComputeFaceNormals(Mesh * mesh, Vec3f * normals)
+{
+    for (int i = 0; i + 2 < mesh->indexes_count; i += 3) {
+        Vec3f a = mesh->positions[mesh->pos_indices[i+0]];
+        Vec3f b = mesh->positions[mesh->pos_indices[i+1]];
+        Vec3f c = mesh->positions[mesh->pos_indices[i+2]];
+        Vec3f n = vec3Cross(vec3fsubV(a, b), vec3fsubV(a, c));
+        float length = sqrtf(vec3Dot(n, n));
+        normals[i/3] = length > 0 ? vec3fmul(n, 1.0f / length) : (Vec3f){0, 0, 0};
+    }
+}
@@ -11,6 +11,11 @@ typedef struct Mesh {
     uint16_t * tex_indices;
     Vec3f * positions;
     Vec2f * textCoord;
+    int positions_count;  // number of positions; 0 if unknown (vertices are then transformed per triangle)
+    Vec3f * face_normals; // unit normal of each triangle in model space; 0 to compute them while rendering
 } Mesh;
 
+// Computes the unit normal of each triangle (indexes_count / 3 of them), for face_normals
+extern void meshComputeFaceNormals(Mesh * mesh, Vec3f * normals);
+
 
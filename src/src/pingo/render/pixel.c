@@ -20,6 +20,11 @@ extern Pixel pixelMul(Pixel p, float f)
     return (Pixel){p.g*f};
 }
 
+extern Pixel pixelMulFixed(Pixel p, int32_t f)
+{
+    return (Pixel){(p.g*f)>>16};
+}
+
 extern Pixel pixelFromRGBA( uint8_t r, uint8_t g, uint8_t b, uint8_t a)
 {
     return (Pixel){((r + g + b) / 3)};
@@ -60,6 +65,11 @@ extern Pixel pixelMul(Pixel p, float f)
     return (Pixel){p.r*f,p.g*f,p.b*f,p.a};
 }
 
+extern Pixel pixelMulFixed(Pixel p, int32_t f)
+{
+    return (Pixel){(p.r*f)>>16,(p.g*f)>>16,(p.b*f)>>16,p.a};
+}
+
 #endif
 
 
@@ -85,4 +95,9 @@ extern Pixel pixelMul(Pixel p, float f)
     return (Pixel){p.b*f,p.g*f,p.r*f,p.a};
 }
 
+extern Pixel pixelMulFixed(Pixel p, int32_t f)
+{
+    return (Pixel){(p.b*f)>>16,(p.g*f)>>16,(p.r*f)>>16,p.a};
+}
+
 #endif
@@ -68,3 +68,4 @@ extern Pixel pixelFromUInt8( uint8_t);
 extern uint8_t pixelToUInt8( Pixel *);
 extern Pixel pixelFromRGBA( uint8_t r, uint8_t g, uint8_t b, uint8_t a);
 extern Pixel pixelMul( Pixel p, float f);
+extern Pixel pixelMulFixed( Pixel p, int32_t f); // f is Q16.16, from 0 to 1.0
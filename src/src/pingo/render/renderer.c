@@ -1,5 +1,6 @@
 #include <string.h>
 #include <stdio.h>
+#include <math.h>
 #include "renderer.h"
 #include "sprite.h"
 #include "pixel.h"
@@ -8,6 +9,7 @@
 #include "scene.h"
 #include "rasterizer.h"
 #include "object.h"
+#include "../math/fixed.h"
 /*#include "../backend/ttgobackend.h"*/
 
 extern void show_pixel(uint8_t a, uint8_t b, uint8_t g, uint8_t r);
@@ -90,80 +92,182 @@ void backendDrawPixel (Renderer * r, Texture * f, Vec2i pos, Pixel color, float
     texture_draw(f, pos, pixelMul(color,illumination));
 }
 
-int renderObject(Mat4 object_transform, Renderer * r, Renderable ren) {
-
-    const Vec2i scrSize = r->frameBuffer.size;
-    Object * o = ren.impl;
-
-    // MODEL MATRIX
-    Mat4 m = mat4MultiplyM( &o->transform, &object_transform  );
+// Outcodes of a transformed vertex; a triangle is skipped if all of its vertices share one
+#define OUTCODE_BEHIND 0x01 // Z > 0 before the perspective division
+#define OUTCODE_LEFT   0x02 // X < -W
+#define OUTCODE_RIGHT  0x04 // X > W
+#define OUTCODE_BOTTOM 0x08 // Y < -W
+#define OUTCODE_TOP    0x10 // Y > W
+
+/**
+ * Face lighting from normals in model space. The model matrix M turns a model-space normal n
+ * into cof(M) * n in world space (the same as the cross product of the transformed edges), so
+ * the light direction is moved into model space once per object, rather than each face
+ * being moved into world space.
+ */
+typedef struct FaceLighting {
+    Vec3f light;          // cof(M)^T * light direction
+    float g[6];           // cof(M)^T * cof(M): xx, yy, zz, xy, xz, yz; gives the world length of a normal
+    float uniform_length; // world length of a unit normal, if M scales uniformly; otherwise 0
+} FaceLighting;
+
+static void faceLightingInit(FaceLighting * fl, Mat4 * m) {
+    const F_TYPE * e = m->elements;
+    Vec3f r0 = { e[0], e[1], e[2] };
+    Vec3f r1 = { e[4], e[5], e[6] };
+    Vec3f r2 = { e[8], e[9], e[10] };
+    Vec3f c[3] = { vec3Cross(r1, r2), vec3Cross(r2, r0), vec3Cross(r0, r1) };
+
+    // Only directions matter, so keep the values near 1 (which the fixed point version needs)
+    float big = 0;
+    for (int k = 0; k < 3; k++) {
+        big = MAX(big, fabsf(c[k].x));
+        big = MAX(big, fabsf(c[k].y));
+        big = MAX(big, fabsf(c[k].z));
+    }
+    if (big > 0)
+        for (int k = 0; k < 3; k++)
+            c[k] = vec3fmul(c[k], 1.0f / big);
+
+    Vec3f light = vec3Normalize((Vec3f){-8,5,5});
+    fl->light = vec3fsumV(vec3fsumV(vec3fmul(c[0], light.x), vec3fmul(c[1], light.y)), vec3fmul(c[2], light.z));
+
+    float * g = fl->g;
+    g[0] = c[0].x * c[0].x + c[1].x * c[1].x + c[2].x * c[2].x;
+    g[1] = c[0].y * c[0].y + c[1].y * c[1].y + c[2].y * c[2].y;
+    g[2] = c[0].z * c[0].z + c[1].z * c[1].z + c[2].z * c[2].z;
+    g[3] = c[0].x * c[0].y + c[1].x * c[1].y + c[2].x * c[2].y;
+    g[4] = c[0].x * c[0].z + c[1].x * c[1].z + c[2].x * c[2].z;
+    g[5] = c[0].y * c[0].z + c[1].y * c[1].z + c[2].y * c[2].z;
+
+    float tolerance = g[0] * 1e-5f;
+    if (fabsf(g[1] - g[0]) <= tolerance && fabsf(g[2] - g[0]) <= tolerance &&
+        fabsf(g[3]) <= tolerance && fabsf(g[4]) <= tolerance && fabsf(g[5]) <= tolerance)
+        fl->uniform_length = sqrtf(g[0]);
+    else
+        fl->uniform_length = 0;
+}
 
-    // VIEW MATRIX
-    Mat4 v = r->camera_view;
-    Mat4 p = r->camera_projection;
+#ifdef PINGO_FLOAT
+
+// Returns the diffuse light for a face, given its normal in model space
+static float faceLightingShade(FaceLighting * fl, Vec3f n, int unit) {
+    float dot = vec3Dot(n, fl->light);
+    float length;
+    if (unit && fl->uniform_length > 0) {
+        length = fl->uniform_length;
+    } else {
+        const float * g = fl->g;
+        length = sqrtf(n.x * n.x * g[0] + n.y * n.y * g[1] + n.z * n.z * g[2] +
+            2.0f * (n.x * n.y * g[3] + n.x * n.z * g[4] + n.y * n.z * g[5]));
+    }
+    if (!(length > 0))
+        return 0.5f;
+    float diffuseLight = (1.0f + dot / length) * 0.5f;
+    return MIN(1.0f, MAX(diffuseLight, 0));
+}
 
-    for (int i = 0; i < o->mesh->indexes_count; i += 3) {
-        Vec3f * ver1 = &o->mesh->positions[o->mesh->pos_indices[i+0]];
-        Vec3f * ver2 = &o->mesh->positions[o->mesh->pos_indices[i+1]];
-        Vec3f * ver3 = &o->mesh->positions[o->mesh->pos_indices[i+2]];
+static void transformVertex(TransformedVertex * t, Vec3f * position, Mat4 * mvp, Vec2i scrSize) {
+    Vec4f c = { position->x, position->y, position->z, 1 };
+    c = mat4MultiplyVec4( &c, mvp);
 
-        Vec2f tca = {0,0};
-        Vec2f tcb = {0,0};
-        Vec2f tcc = {0,0};
+    uint8_t outcode = c.z > 0 ? OUTCODE_BEHIND : 0;
+    if (c.w > 0) {
+        if (c.x < -c.w) outcode |= OUTCODE_LEFT;
+        if (c.x > c.w) outcode |= OUTCODE_RIGHT;
+        if (c.y < -c.w) outcode |= OUTCODE_BOTTOM;
+        if (c.y > c.w) outcode |= OUTCODE_TOP;
+    }
+    t->outcode = outcode;
 
-        if (o->material != 0) {
-            tca = o->mesh->textCoord[o->mesh->tex_indices[i+0]];
-            tcb = o->mesh->textCoord[o->mesh->tex_indices[i+1]];
-            tcc = o->mesh->textCoord[o->mesh->tex_indices[i+2]];
-        }
+    // convert to device coordinates by perspective division
+    float w = 1.0f / c.w;
+    t->ndc = (Vec3f){ c.x * w, c.y * w, c.z * w };
 
-        Vec4f a =  { ver1->x, ver1->y, ver1->z, 1 };
-        Vec4f b =  { ver2->x, ver2->y, ver2->z, 1 };
-        Vec4f c =  { ver3->x, ver3->y, ver3->z, 1 };
+    //Compute Screen coordinates
+    float halfX = scrSize.x/2;
+    float halfY = scrSize.y/2;
+    t->screen = (Vec2i){ t->ndc.x * halfX + halfX, t->ndc.y * halfY + halfY };
+}
 
-        a = mat4MultiplyVec4( &a, &m);
-        b = mat4MultiplyVec4( &b, &m);
-        c = mat4MultiplyVec4( &c, &m);
+int renderObject(Mat4 object_transform, Renderer * r, Renderable ren) {
 
-        //Calc Face Normal
-        Vec3f na = vec3fsubV(*((Vec3f*)(&a)), *((Vec3f*)(&b)));
-        Vec3f nb = vec3fsubV(*((Vec3f*)(&a)), *((Vec3f*)(&c)));
-        Vec3f normal = vec3Normalize(vec3Cross(na, nb));
-        Vec3f light = vec3Normalize((Vec3f){-8,5,5});
-        float diffuseLight = (1.0 + vec3Dot(normal, light)) *0.5;
-        diffuseLight = MIN(1.0, MAX(diffuseLight, 0));
+    const Vec2i scrSize = r->frameBuffer.size;
+    Object * o = ren.impl;
+    Mesh * mesh = o->mesh;
 
-        a = mat4MultiplyVec4( &a, &v);
-        b = mat4MultiplyVec4( &b, &v);
-        c = mat4MultiplyVec4( &c, &v);
+    // MODEL MATRIX
+    Mat4 m = mat4MultiplyM( &o->transform, &object_transform  );
 
-        a = mat4MultiplyVec4( &a, &p);
-        b = mat4MultiplyVec4( &b, &p);
-        c = mat4MultiplyVec4( &c, &p);
+    // VIEW and PROJECTION MATRICES, combined with the model matrix, since lighting
+    // uses face normals in model space rather than positions in world space
+    Mat4 mv = mat4MultiplyM( &m, &r->camera_view );
+    Mat4 mvp = mat4MultiplyM( &mv, &r->camera_projection );
+
+    FaceLighting lighting;
+    faceLightingInit(&lighting, &m);
+
+    // Transform each vertex once, if the cache can hold them all
+    TransformedVertex * cache = 0;
+    TransformedVertex corners[3];
+    if (r->vertex_cache && mesh->positions_count > 0 && mesh->positions_count <= r->vertex_cache_size) {
+        cache = r->vertex_cache;
+        for (int k = 0; k < mesh->positions_count; k++)
+            transformVertex(&cache[k], &mesh->positions[k], &mvp, scrSize);
+    }
 
+    for (int i = 0; i < mesh->indexes_count; i += 3) {
+        TransformedVertex * ta, * tb, * tc;
+        if (cache) {
+            ta = &cache[mesh->pos_indices[i+0]];
+            tb = &cache[mesh->pos_indices[i+1]];
+            tc = &cache[mesh->pos_indices[i+2]];
+        } else {
+            ta = &corners[0];
+            tb = &corners[1];
+            tc = &corners[2];
+            transformVertex(ta, &mesh->positions[mesh->pos_indices[i+0]], &mvp, scrSize);
+            transformVertex(tb, &mesh->positions[mesh->pos_indices[i+1]], &mvp, scrSize);
+            transformVertex(tc, &mesh->positions[mesh->pos_indices[i+2]], &mvp, scrSize);
+        }
 
-        //Triangle is completely behind camera
-        if (a.z > 0 && b.z > 0 && c.z > 0)
+        //Triangle is completely behind camera, or completely beyond one side of the view
+        if (ta->outcode & tb->outcode & tc->outcode)
            continue;
 
-        // convert to device coordinates by perspective division
-        a.w = 1.0 / a.w;
-        b.w = 1.0 / b.w;
-        c.w = 1.0 / c.w;
-        a.x *= a.w; a.y *= a.w; a.z *= a.w;
-        b.x *= b.w; b.y *= b.w; b.z *= b.w;
-        c.x *= c.w; c.y *= c.w; c.z *= c.w;
+        Vec3f a = ta->ndc;
+        Vec3f b = tb->ndc;
+        Vec3f c = tc->ndc;
 
         float clocking = isClockWise(a.x, a.y, b.x, b.y, c.x, c.y);
         if (clocking >= 0)
             continue;
 
-        //Compute Screen coordinates
-        float halfX = scrSize.x/2;
-        float halfY = scrSize.y/2;
-        Vec2i a_s = {a.x * halfX + halfX,  a.y * halfY + halfY};
-        Vec2i b_s = {b.x * halfX + halfX,  b.y * halfY + halfY};
-        Vec2i c_s = {c.x * halfX + halfX,  c.y * halfY + halfY};
+        //Face lighting, only for faces that may be drawn
+        float diffuseLight;
+        if (mesh->face_normals) {
+            diffuseLight = faceLightingShade(&lighting, mesh->face_normals[i/3], 1);
+        } else {
+            Vec3f * pa = &mesh->positions[mesh->pos_indices[i+0]];
+            Vec3f * pb = &mesh->positions[mesh->pos_indices[i+1]];
+            Vec3f * pc = &mesh->positions[mesh->pos_indices[i+2]];
+            Vec3f normal = vec3Cross(vec3fsubV(*pa, *pb), vec3fsubV(*pa, *pc));
+            diffuseLight = faceLightingShade(&lighting, normal, 0);
+        }
+
+        Vec2f tca = {0,0};
+        Vec2f tcb = {0,0};
+        Vec2f tcc = {0,0};
+
+        if (o->material != 0) {
+            tca = mesh->textCoord[mesh->tex_indices[i+0]];
+            tcb = mesh->textCoord[mesh->tex_indices[i+1]];
+            tcc = mesh->textCoord[mesh->tex_indices[i+2]];
+        }
+
+        Vec2i a_s = ta->screen;
+        Vec2i b_s = tb->screen;
+        Vec2i c_s = tc->screen;
 
         int32_t minX = MIN(MIN(a_s.x, b_s.x), c_s.x);
         int32_t minY = MIN(MIN(a_s.y, b_s.y), c_s.y);
@@ -249,12 +353,308 @@ int renderObject(Mat4 object_transform, Renderer * r, Renderable ren) {
     return 0;
 };
 
+#else // PINGO_FIXED
+
+// Limits that keep the integer edge functions and interpolation within range
+#define NDC_XY_LIMIT (16 * FIX16_ONE)   // Q16.16
+#define NDC_Z_LIMIT  (16 << 24)         // Q8.24
+#define TEX_LIMIT    (256 * FIX16_ONE)  // Q16.16
+
+void backendDrawPixelFixed (Renderer * r, Texture * f, Vec2i pos, Pixel color, Fix16 illumination) {
+    //If backend spcifies something..
+    if (r->backEnd->drawPixel != 0)
+        r->backEnd->drawPixel(f, pos, color, fix16ToFloat(illumination));
+
+    //By default call this
+    texture_draw(f, pos, pixelMulFixed(color, illumination));
+}
+
+// FaceLighting, in Q16.16
+typedef struct FaceLightingX {
+    Fix16 light[3];
+    Fix16 g[6];
+    Fix16 uniform_length;
+} FaceLightingX;
+
+static void faceLightingInitFixed(FaceLightingX * flx, Mat4 * m) {
+    FaceLighting fl;
+    faceLightingInit(&fl, m);
+    flx->light[0] = fix16FromFloat(fl.light.x);
+    flx->light[1] = fix16FromFloat(fl.light.y);
+    flx->light[2] = fix16FromFloat(fl.light.z);
+    for (int k = 0; k < 6; k++)
+        flx->g[k] = fix16FromFloat(fl.g[k]);
+    flx->uniform_length = fix16FromFloat(fl.uniform_length);
+}
+
+// Returns the diffuse light for a face, given its normal in model space (Q16.16, no longer than 1)
+static Fix16 faceLightingShadeFixed(FaceLightingX * fl, Fix16 nx, Fix16 ny, Fix16 nz, int unit) {
+    int64_t dot = ((int64_t)nx * fl->light[0] + (int64_t)ny * fl->light[1] + (int64_t)nz * fl->light[2]) >> 16;
+    int64_t length;
+    if (unit && fl->uniform_length > 0) {
+        length = fl->uniform_length;
+    } else {
+        const Fix16 * g = fl->g;
+        int64_t length2 = (((int64_t)nx * nx >> 16) * g[0] + ((int64_t)ny * ny >> 16) * g[1] +
+            ((int64_t)nz * nz >> 16) * g[2] + 2 * (((int64_t)nx * ny >> 16) * g[3] +
+            ((int64_t)nx * nz >> 16) * g[4] + ((int64_t)ny * nz >> 16) * g[5])) >> 16;
+        length = length2 > 0 ? fixSqrt64((uint64_t)length2 << 16) : 0;
+    }
+    if (length <= 0)
+        return FIX16_ONE / 2;
+    Fix16 diffuseLight = (Fix16)((FIX16_ONE + fixMulDivShift(dot, (int32_t)length, 16)) / 2);
+    return MIN(FIX16_ONE, MAX(diffuseLight, 0));
+}
+
+// Returns the diffuse light for a face without a stored normal, from its positions in model space
+static Fix16 faceLightingShadeFromPositions(FaceLightingX * fl, Vec3f * pa, Vec3f * pb, Vec3f * pc) {
+    Vec4x a = vec4xFromVec3f(pa);
+    Vec4x b = vec4xFromVec3f(pb);
+    Vec4x c = vec4xFromVec3f(pc);
+    int64_t nax = (int64_t)a.x - b.x, nay = (int64_t)a.y - b.y, naz = (int64_t)a.z - b.z;
+    int64_t nbx = (int64_t)a.x - c.x, nby = (int64_t)a.y - c.y, nbz = (int64_t)a.z - c.z;
+    int64_t n[3] = { nay * nbz - nby * naz, naz * nbx - nbz * nax, nax * nby - nbx * nay };
+
+    // Only the direction matters, so scale the normal to no longer than 1 in Q16.16
+    uint64_t big = 0;
+    for (int k = 0; k < 3; k++)
+        big |= n[k] < 0 ? (uint64_t)-n[k] : (uint64_t)n[k];
+    if (big == 0)
+        return FIX16_ONE / 2;
+    int bits = 64 - __builtin_clzll(big);
+    for (int k = 0; k < 3; k++)
+        n[k] = bits > 15 ? n[k] >> (bits - 15) : n[k] << (15 - bits);
+
+    return faceLightingShadeFixed(fl, (Fix16)n[0], (Fix16)n[1], (Fix16)n[2], 0);
+}
+
+static void transformVertexFixed(TransformedVertex * t, Vec3f * position, Mat4x * mvp, int32_t halfX, int32_t halfY) {
+    Vec4x c = vec4xFromVec3f(position);
+    c = mat4xMultiplyVec4( &c, mvp);
+
+    uint8_t outcode = c.z > 0 ? OUTCODE_BEHIND : 0;
+    if (c.w > 0) {
+        if (c.x < -c.w) outcode |= OUTCODE_LEFT;
+        if (c.x > c.w) outcode |= OUTCODE_RIGHT;
+        if (c.y < -c.w) outcode |= OUTCODE_BOTTOM;
+        if (c.y > c.w) outcode |= OUTCODE_TOP;
+    }
+    t->outcode = outcode;
+
+    // convert to device coordinates by perspective division, through the reciprocal table;
+    // Z keeps 24 fraction bits, because the depth test separates nearby surfaces with it
+    Fix16 w = fix16Reciprocal(c.w);
+    t->x = fix16Clamp(fix16Mul(c.x, w), NDC_XY_LIMIT);
+    t->y = fix16Clamp(fix16Mul(c.y, w), NDC_XY_LIMIT);
+    t->z = fix16Clamp(fix16Saturate(((int64_t)c.z * w) >> 8), NDC_Z_LIMIT);
+
+    //Compute Screen coordinates
+    t->screen = (Vec2i){(int32_t)(((int64_t)t->x * halfX) >> 16) + halfX, (int32_t)(((int64_t)t->y * halfY) >> 16) + halfY};
+}
+
+int renderObject(Mat4 object_transform, Renderer * r, Renderable ren) {
+
+    const Vec2i scrSize = r->frameBuffer.size;
+    Object * o = ren.impl;
+    Mesh * mesh = o->mesh;
+
+    // MODEL MATRIX (the matrices are built in floating point once per object, then converted)
+    Mat4 m = mat4MultiplyM( &o->transform, &object_transform  );
+
+    // VIEW and PROJECTION MATRICES, combined with the model matrix, since lighting
+    // uses face normals in model space rather than positions in world space
+    Mat4 mv = mat4MultiplyM( &m, &r->camera_view );
+    Mat4 mvpf = mat4MultiplyM( &mv, &r->camera_projection );
+    Mat4x mvp = mat4xFromMat4(&mvpf);
+
+    FaceLightingX lighting;
+    faceLightingInitFixed(&lighting, &m);
+
+    PingoDepth * zeta = r->backEnd->getZetaBuffer(r,r->backEnd);
+    const int32_t halfX = scrSize.x/2;
+    const int32_t halfY = scrSize.y/2;
+
+    // Transform each vertex once, if the cache can hold them all
+    TransformedVertex * cache = 0;
+    TransformedVertex corners[3];
+    if (r->vertex_cache && mesh->positions_count > 0 && mesh->positions_count <= r->vertex_cache_size) {
+        cache = r->vertex_cache;
+        for (int k = 0; k < mesh->positions_count; k++)
+            transformVertexFixed(&cache[k], &mesh->positions[k], &mvp, halfX, halfY);
+    }
+
+    for (int i = 0; i < mesh->indexes_count; i += 3) {
+        TransformedVertex * ta, * tb, * tc;
+        if (cache) {
+            ta = &cache[mesh->pos_indices[i+0]];
+            tb = &cache[mesh->pos_indices[i+1]];
+            tc = &cache[mesh->pos_indices[i+2]];
+        } else {
+            ta = &corners[0];
+            tb = &corners[1];
+            tc = &corners[2];
+            transformVertexFixed(ta, &mesh->positions[mesh->pos_indices[i+0]], &mvp, halfX, halfY);
+            transformVertexFixed(tb, &mesh->positions[mesh->pos_indices[i+1]], &mvp, halfX, halfY);
+            transformVertexFixed(tc, &mesh->positions[mesh->pos_indices[i+2]], &mvp, halfX, halfY);
+        }
+
+        //Triangle is completely behind camera, or completely beyond one side of the view
+        if (ta->outcode & tb->outcode & tc->outcode)
+           continue;
+
+        int64_t clocking = (int64_t)(tb->y - ta->y) * (tc->x - tb->x) - (int64_t)(tc->y - tb->y) * (tb->x - ta->x);
+        if (clocking >= 0)
+            continue;
+
+        //Face lighting, only for faces that may be drawn
+        Fix16 diffuseLight;
+        if (mesh->face_normals) {
+            Vec3f * n = &mesh->face_normals[i/3];
+            diffuseLight = faceLightingShadeFixed(&lighting,
+                fix16FromFloat(n->x), fix16FromFloat(n->y), fix16FromFloat(n->z), 1);
+        } else {
+            diffuseLight = faceLightingShadeFromPositions(&lighting,
+                &mesh->positions[mesh->pos_indices[i+0]],
+                &mesh->positions[mesh->pos_indices[i+1]],
+                &mesh->positions[mesh->pos_indices[i+2]]);
+        }
+
+        int32_t az = ta->z;
+        int32_t bz = tb->z;
+        int32_t cz = tc->z;
+
+        Vec2i a_s = ta->screen;
+        Vec2i b_s = tb->screen;
+        Vec2i c_s = tc->screen;
+
+        int32_t minX = MIN(MIN(a_s.x, b_s.x), c_s.x);
+        int32_t minY = MIN(MIN(a_s.y, b_s.y), c_s.y);
+        int32_t maxX = MAX(MAX(a_s.x, b_s.x), c_s.x);
+        int32_t maxY = MAX(MAX(a_s.y, b_s.y), c_s.y);
+
+        minX = MIN(MAX(minX, 0), r->frameBuffer.size.x);
+        minY = MIN(MAX(minY, 0), r->frameBuffer.size.y);
+        maxX = MIN(MAX(maxX, 0), r->frameBuffer.size.x);
+        maxY = MIN(MAX(maxY, 0), r->frameBuffer.size.y);
+
+        // Barycentric coordinates at minX/minY corner
+        Vec2i minTriangle = { minX, minY };
+
+        int32_t area =  orient2d( a_s, b_s, c_s);
+        if (area == 0)
+            continue;
+
+        int32_t A01 = ( a_s.y - b_s.y); //Barycentric coordinates steps
+        int32_t B01 = ( b_s.x - a_s.x); //Barycentric coordinates steps
+        int32_t A12 = ( b_s.y - c_s.y); //Barycentric coordinates steps
+        int32_t B12 = ( c_s.x - b_s.x); //Barycentric coordinates steps
+        int32_t A20 = ( c_s.y - a_s.y); //Barycentric coordinates steps
+        int32_t B20 = ( a_s.x - c_s.x); //Barycentric coordinates steps
+
+        int32_t w0_row = orient2d( b_s, c_s, minTriangle);
+        int32_t w1_row = orient2d( c_s, a_s, minTriangle);
+        int32_t w2_row = orient2d( a_s, b_s, minTriangle);
+
+        // Depth and texture coordinates are planes over the triangle, stepped in Q32.32.
+        // Each plane starts from its value at vertex A; the start and the steps use wrapping
+        // arithmetic, so a far-away bounding box corner cannot corrupt values inside the triangle.
+        int32_t dx = minX - a_s.x;
+        int32_t dy = minY - a_s.y;
+
+        int64_t depth_dx = -fixMulDivShift((int64_t)A12 * az + (int64_t)A20 * bz + (int64_t)A01 * cz, area, 8);
+        int64_t depth_dy = -fixMulDivShift((int64_t)B12 * az + (int64_t)B20 * bz + (int64_t)B01 * cz, area, 8);
+        uint64_t depth_row = ((uint64_t)(-(int64_t)az) << 8) + (uint64_t)depth_dx * dx + (uint64_t)depth_dy * dy;
+
+        int64_t u_dx = 0, u_dy = 0, v_dx = 0, v_dy = 0;
+        uint64_t u_row = 0, v_row = 0;
+
+        if (o->material != 0) {
+            Vec2f * tca = &mesh->textCoord[mesh->tex_indices[i+0]];
+            Vec2f * tcb = &mesh->textCoord[mesh->tex_indices[i+1]];
+            Vec2f * tcc = &mesh->textCoord[mesh->tex_indices[i+2]];
+
+            Fix16 raz = fix16Reciprocal(az >> 8);
+            Fix16 rbz = fix16Reciprocal(bz >> 8);
+            Fix16 rcz = fix16Reciprocal(cz >> 8);
+
+            Fix16 ua = fix16Clamp(fix16Mul(fix16FromFloat(tca->x), raz), TEX_LIMIT);
+            Fix16 va = fix16Clamp(fix16Mul(fix16FromFloat(tca->y), raz), TEX_LIMIT);
+            Fix16 ub = fix16Clamp(fix16Mul(fix16FromFloat(tcb->x), rbz), TEX_LIMIT);
+            Fix16 vb = fix16Clamp(fix16Mul(fix16FromFloat(tcb->y), rbz), TEX_LIMIT);
+            Fix16 uc = fix16Clamp(fix16Mul(fix16FromFloat(tcc->x), rcz), TEX_LIMIT);
+            Fix16 vc = fix16Clamp(fix16Mul(fix16FromFloat(tcc->y), rcz), TEX_LIMIT);
+
+            u_dx = -fixMulDivShift((int64_t)A12 * ua + (int64_t)A20 * ub + (int64_t)A01 * uc, area, 16);
+            u_dy = -fixMulDivShift((int64_t)B12 * ua + (int64_t)B20 * ub + (int64_t)B01 * uc, area, 16);
+            v_dx = -fixMulDivShift((int64_t)A12 * va + (int64_t)A20 * vb + (int64_t)A01 * vc, area, 16);
+            v_dy = -fixMulDivShift((int64_t)B12 * va + (int64_t)B20 * vb + (int64_t)B01 * vc, area, 16);
+            u_row = ((uint64_t)(-(int64_t)ua) << 16) + (uint64_t)u_dx * dx + (uint64_t)u_dy * dy;
+            v_row = ((uint64_t)(-(int64_t)va) << 16) + (uint64_t)v_dx * dx + (uint64_t)v_dy * dy;
+        }
+
+        for (int16_t y = minY; y < maxY; y++, w0_row += B12,w1_row += B20,w2_row += B01,
+                depth_row += depth_dy, u_row += u_dy, v_row += v_dy) {
+            int32_t w0 = w0_row;
+            int32_t w1 = w1_row;
+            int32_t w2 = w2_row;
+            uint64_t depth_acc = depth_row;
+            uint64_t u_acc = u_row;
+            uint64_t v_acc = v_row;
+
+            for (int32_t x = minX; x < maxX; x++, w0 += A12, w1 += A20, w2 += A01,
+                    depth_acc += depth_dx, u_acc += u_dx, v_acc += v_dx) {
+
+                if ((w0 | w1 | w2) < 0)
+                    continue;
+
+                int64_t depth = (int64_t)depth_acc; // Q32.32
+                if (depth < 0 || depth > ((int64_t)1 << 32))
+                    continue;
+
+                // 1-depth, in 0.32 fixed point
+                uint64_t inverse = ((uint64_t)1 << 32) - (uint64_t)depth;
+                uint32_t zvalue = inverse > UINT32_MAX ? UINT32_MAX : (uint32_t)inverse;
+                if (depth_check_fixed(zeta, x + y * scrSize.x, zvalue))
+                    continue;
+
+                depth_write_fixed(zeta, x + y * scrSize.x, zvalue);
+
+                if (o->material != 0) {
+                    //Texture lookup
+                    int32_t depth16 = (int32_t)(depth >> 16);
+                    int32_t textCoordx = (int32_t)((((int64_t)u_acc >> 16) * depth16) >> 16);
+                    int32_t textCoordy = (int32_t)((((int64_t)v_acc >> 16) * depth16) >> 16);
+
+                    Pixel text = texture_readFixed(o->material->texture, textCoordx, textCoordy);
+
+                    backendDrawPixelFixed(r, &r->frameBuffer, (Vec2i){x,y}, text, diffuseLight);
+                } else {
+                    Pixel pixel;
+                    pixel.a = 255;
+                    pixel.b = 255;
+                    pixel.g = 0;
+                    pixel.r = 255;
+                    backendDrawPixelFixed(r, &r->frameBuffer, (Vec2i){x,y}, pixel, diffuseLight);
+                }
+
+            }
+
+        }
+    }
+
+    return 0;
+};
+
+#endif // PINGO_FIXED
+
 int rendererInit(Renderer * r, Vec2i size, BackEnd * backEnd) {
     renderingFunctions[RENDERABLE_SPRITE] = & renderSprite;
     renderingFunctions[RENDERABLE_SCENE] = & renderScene;
     renderingFunctions[RENDERABLE_OBJECT] = & renderObject;
 
     r->scene = 0;
+    r->vertex_cache = 0;
+    r->vertex_cache_size = 0;
     r->clear = 1;
     r->clearColor = PIXELBLACK;
     r->backEnd = backEnd;
@@ -306,3 +706,15 @@ int rendererSetCamera(Renderer * r, Vec4i rect) {
 };
     return 0;
 }
+
+int rendererSetVertexCache(Renderer * r, TransformedVertex * cache, int size) {
+    if (cache == 0 || size <= 0) {
+        r->vertex_cache = 0;
+        r->vertex_cache_size = 0;
+        return 1; //no room
+    }
+
+    r->vertex_cache = cache;
+    r->vertex_cache_size = size;
+    return 0;
+}
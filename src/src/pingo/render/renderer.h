@@ -8,6 +8,21 @@
 typedef struct Scene Scene;
 typedef struct BackEnd BackEnd;
 
+/**
+ * A vertex of the object being rendered, after it is transformed and projected
+ */
+typedef struct TransformedVertex {
+#ifdef PINGO_FIXED
+    int32_t x;      // normalized device coordinates, Q16.16
+    int32_t y;
+    int32_t z;      // Q8.24, for the depth test
+#else
+    Vec3f ndc;      // normalized device coordinates
+#endif
+    Vec2i screen;
+    uint8_t outcode; // OUTCODE_xxx bits, so triangles outside the view are skipped
+} TransformedVertex;
+
 typedef struct Renderer{
     Vec4i camera;
     Scene * scene;
@@ -21,6 +36,9 @@ typedef struct Renderer{
 
     BackEnd * backEnd;
 
+    TransformedVertex * vertex_cache;
+    int vertex_cache_size;
+
 } Renderer;
 
 extern int rendererRender(Renderer *);
@@ -30,3 +48,7 @@ extern int rendererInit(Renderer *, Vec2i size, struct BackEnd * backEnd);
 extern int rendererSetScene(Renderer *r, Scene *s);
 
 extern int rendererSetCamera(Renderer *r, Vec4i camera);
+
+// Provides room to transform each vertex of a mesh once, rather than once per triangle using it.
+// Meshes with more positions than the cache holds (or an unknown count) are still rendered.
+extern int rendererSetVertexCache(Renderer *r, TransformedVertex * cache, int size);
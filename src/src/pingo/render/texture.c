@@ -28,7 +28,7 @@ Pixel texture_read(Texture *f, Vec2i pos)
 Pixel texture_readF(Texture *f, Vec2f pos)
 {
     uint16_t x = (uint16_t)(pos.x * f->size.x) % f->size.x;
-    uint16_t y = (uint16_t)(pos.y * f->size.y) % f->size.x;
+    uint16_t y = (uint16_t)(pos.y * f->size.y) % f->size.y;
     uint32_t index = x + y * f->size.x;
     Pixel value = f->frameBuffer[index];
     return value;
@@ -37,3 +37,12 @@ Pixel texture_readF(Texture *f, Vec2f pos)
 
 
 
+
+Pixel texture_readFixed(Texture *f, int32_t u, int32_t v)
+{
+    int32_t x = (int32_t)(((int64_t)u * f->size.x) >> 16) % f->size.x;
+    int32_t y = (int32_t)(((int64_t)v * f->size.y) >> 16) % f->size.y;
+    if (x < 0) x += f->size.x;
+    if (y < 0) y += f->size.y;
+    return f->frameBuffer[x + y * f->size.x];
+}
@@ -19,3 +19,6 @@ extern Pixel texture_read(Texture * f, Vec2i pos);
 
 extern Pixel texture_readF(Texture * f, Vec2f pos);
 
+// Reads with Q16.16 texture coordinates, where 1.0 is the texture width or height
+extern Pixel texture_readFixed(Texture * f, int32_t u, int32_t v);
+
@@ -0,0 +1,269 @@
+// pingo_bench.c - time the pingo object renderer on the teapot, on the host
+//
+// The renderer uses floating point or fixed point arithmetic, selected at build time,
+// so build one program per mode, and compare their timings and output images.
+//
+// Linux program compilation (from this directory):
+// gcc -O2 pingo_bench.c ../pingo/math/*.c ../pingo/render/*.c ../pingo/assets/teapot.c -lm -o pingo_bench_float
+// gcc -O2 -DPINGO_FIXED pingo_bench.c ../pingo/math/*.c ../pingo/render/*.c ../pingo/assets/teapot.c -lm -o pingo_bench_fixed
+//
+// Usage: pingo_bench_xxx [-n frames] [-t] [-i] [-u] [-o out.ppm] [-c ref.ppm]
+//   -n  number of frames to render (default 200), rotating the teapot a little each frame
+//   -t  render with a texture (a material), rather than with the flat color
+//   -i  share the teapot's duplicate positions between triangles (the asset lists each
+//       triangle's positions separately), as an indexed mesh would
+//   -u  render without the vertex cache and face normals, transforming each position
+//       once per triangle, and lighting each triangle from its positions
+//   -o  write the last frame as a PPM image
+//   -c  count the pixels of the last frame that differ from a PPM image (such as one
+//       written by the other program)
+//
+// Example:
+// ./pingo_bench_float -o float.ppm && ./pingo_bench_fixed -c float.ppm
+
+#ifndef ARDUINO // host program only
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../pingo/assets/teapot.h"
+#include "../pingo/render/backend.h"
+#include "../pingo/render/depth.h"
+#include "../pingo/render/object.h"
+#include "../pingo/render/pixel.h"
+#include "../pingo/render/renderer.h"
+#include "../pingo/render/scene.h"
+
+#define WIDTH  320
+#define HEIGHT 240
+
+static Pixel frame_buffer[WIDTH * HEIGHT];
+static PingoDepth depth_buffer[WIDTH * HEIGHT];
+
+#define MAX_POSITIONS 2048
+static TransformedVertex vertex_cache[MAX_POSITIONS];
+static Vec3f face_normals[MAX_POSITIONS];
+static Vec3f shared_positions[MAX_POSITIONS];
+static uint16_t shared_indices[MAX_POSITIONS];
+
+void show_pixel(uint8_t a, uint8_t b, uint8_t g, uint8_t r) {
+}
+
+static void bench_init(Renderer * ren, BackEnd * backEnd, Vec4i rect) {
+}
+
+static void bench_before_render(Renderer * ren, BackEnd * backEnd) {
+}
+
+static void bench_after_render(Renderer * ren, BackEnd * backEnd) {
+}
+
+static Pixel * bench_get_frame_buffer(Renderer * ren, BackEnd * backEnd) {
+    return frame_buffer;
+}
+
+static PingoDepth * bench_get_zeta_buffer(Renderer * ren, BackEnd * backEnd) {
+    return depth_buffer;
+}
+
+// Make an indexed copy of a mesh, in which equal positions are stored once.
+static void share_positions(Mesh * dst, const Mesh * src) {
+    int count = 0;
+    for (int i = 0; i < src->indexes_count; i++) {
+        Vec3f p = src->positions[src->pos_indices[i]];
+        int k = 0;
+        while (k < count && memcmp(&shared_positions[k], &p, sizeof(Vec3f)))
+            k++;
+        if (k == count)
+            shared_positions[count++] = p;
+        shared_indices[i] = (uint16_t)k;
+    }
+    *dst = *src;
+    dst->positions = shared_positions;
+    dst->positions_count = count;
+    dst->pos_indices = shared_indices;
+}
+
+static double now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static int write_ppm(const char * path) {
+    FILE * fout = fopen(path, "wb");
+    if (!fout) {
+        printf("Cannot create %s\n", path);
+        return 1;
+    }
+    fprintf(fout, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        uint8_t rgb[3] = { frame_buffer[i].r, frame_buffer[i].g, frame_buffer[i].b };
+        fwrite(rgb, 1, 3, fout);
+    }
+    fclose(fout);
+    return 0;
+}
+
+static int compare_ppm(const char * path) {
+    FILE * fin = fopen(path, "rb");
+    int w = 0, h = 0, max = 0;
+    if (!fin) {
+        printf("Cannot open %s\n", path);
+        return 1;
+    }
+    if (fscanf(fin, "P6 %d %d %d", &w, &h, &max) != 3 || w != WIDTH || h != HEIGHT) {
+        printf("%s is not a %dx%d PPM image\n", path, WIDTH, HEIGHT);
+        fclose(fin);
+        return 1;
+    }
+    fgetc(fin);
+    int differ = 0, max_delta = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        uint8_t rgb[3];
+        if (fread(rgb, 1, 3, fin) != 3)
+            break;
+        int dr = abs(rgb[0] - frame_buffer[i].r);
+        int dg = abs(rgb[1] - frame_buffer[i].g);
+        int db = abs(rgb[2] - frame_buffer[i].b);
+        int delta = dr > dg ? (dr > db ? dr : db) : (dg > db ? dg : db);
+        if (delta) {
+            differ++;
+            if (delta > max_delta)
+                max_delta = delta;
+        }
+    }
+    fclose(fin);
+    printf("%d of %d pixels differ from %s (largest channel difference %d)\n",
+        differ, WIDTH * HEIGHT, path, max_delta);
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    int frames = 200;
+    int textured = 0;
+    int indexed = 0;
+    int uncached = 0;
+    const char * out_path = NULL;
+    const char * ref_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-t")) {
+            textured = 1;
+        } else if (!strcmp(argv[i], "-i")) {
+            indexed = 1;
+        } else if (!strcmp(argv[i], "-u")) {
+            uncached = 1;
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            ref_path = argv[++i];
+        } else {
+            printf("Usage: %s [-n frames] [-t] [-i] [-u] [-o out.ppm] [-c ref.ppm]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1)
+        frames = 1;
+
+    BackEnd backend;
+    backend.init = &bench_init;
+    backend.beforeRender = &bench_before_render;
+    backend.afterRender = &bench_after_render;
+    backend.getFrameBuffer = &bench_get_frame_buffer;
+    backend.getZetaBuffer = &bench_get_zeta_buffer;
+    backend.drawPixel = 0;
+
+    Vec2i size = { WIDTH, HEIGHT };
+    Renderer renderer;
+    rendererInit(&renderer, size, &backend);
+    rendererSetCamera(&renderer, (Vec4i) { 0, 0, size.x, size.y });
+    if (!uncached)
+        rendererSetVertexCache(&renderer, vertex_cache, MAX_POSITIONS);
+
+    Scene scene;
+    sceneInit(&scene);
+    rendererSetScene(&renderer, &scene);
+
+    // A 3x3 texture; the teapot maps every vertex to the middle of its center pixel
+    Pixel tex_pixels[9];
+    for (int i = 0; i < 9; i++)
+        tex_pixels[i] = (Pixel) { (uint8_t)(i * 28), 0x40, (uint8_t)(0xFF - i * 28), 0xFF };
+    Texture texture;
+    texture_init(&texture, (Vec2i) { 3, 3 }, tex_pixels);
+    Material material;
+    material.texture = &texture;
+
+    if (mesh_teapot.indexes_count > MAX_POSITIONS) {
+        printf("The teapot has more than %d indices\n", MAX_POSITIONS);
+        return 1;
+    }
+    Mesh mesh = mesh_teapot;
+    if (indexed)
+        share_positions(&mesh, &mesh_teapot);
+    if (uncached) {
+        mesh.face_normals = NULL;
+    } else {
+        meshComputeFaceNormals(&mesh, face_normals);
+        mesh.face_normals = face_normals;
+    }
+
+    Object object;
+    object.mesh = &mesh;
+    object.material = textured ? &material : NULL;
+    sceneAddRenderable(&scene, object_as_renderable(&object));
+
+    // The same camera as the original teapot demo
+    renderer.camera_projection = mat4Perspective(1, 2500.0, (float)size.x / (float)size.y, 0.6);
+    Mat4 v = mat4Translate((Vec3f) { 0, 2, -35 });
+    Mat4 rotateDown = mat4RotateX(-0.40);
+    renderer.camera_view = mat4MultiplyM(&rotateDown, &v);
+
+    double total_ms = 0;
+    double best_ms = 1e9;
+    for (int f = 0; f < frames; f++) {
+        Mat4 s = mat4Scale((Vec3f) { 6.0f, 6.0f, 6.0f });
+        Mat4 t = mat4RotateZ(3.142128f);
+        object.transform = mat4MultiplyM(&s, &t);
+        scene.transform = mat4RotateY(f * 0.03f);
+
+        double start = now_ms();
+        rendererRender(&renderer);
+        double elapsed = now_ms() - start;
+        total_ms += elapsed;
+        if (elapsed < best_ms)
+            best_ms = elapsed;
+    }
+
+    uint32_t drawn = 0;
+    uint32_t checksum = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+        if (frame_buffer[i].a)
+            drawn++;
+        checksum = checksum * 31 + (frame_buffer[i].r | (frame_buffer[i].g << 8) | (frame_buffer[i].b << 16));
+    }
+
+#ifdef PINGO_FIXED
+    const char * mode = "fixed";
+#else
+    const char * mode = "float";
+#endif
+    printf("%s%s%s%s: %d frames of %dx%d, %.3f ms/frame average, %.3f ms best\n",
+        mode, textured ? " textured" : "", indexed ? " indexed" : "", uncached ? " uncached" : "",
+        frames, WIDTH, HEIGHT, total_ms / frames, best_ms);
+    printf("mesh: %d positions, %d triangles\n", mesh.positions_count, mesh.indexes_count / 3);
+    printf("last frame: %u pixels drawn, checksum %08X\n", drawn, checksum);
+
+    if (out_path && write_ppm(out_path))
+        return 1;
+    if (ref_path && compare_ppm(ref_path))
+        return 1;
+    return 0;
+}
+
+#endif // ARDUINO